@@ -0,0 +1,121 @@
+#ifndef BACKING_MEMORY_H
+#define BACKING_MEMORY_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "snapshot.h"
+
+#define BACKING_PAGE_BITS 12 // blocks per page = 2^BACKING_PAGE_BITS
+#define BACKING_PAGE_BLOCKS (1 << BACKING_PAGE_BITS)
+
+/*
+    Block addressable main memory over the full 64-bit block address space. Every block initially holds its own
+    address. Pages of BACKING_PAGE_BLOCKS blocks are allocated on their first write and found through a hashed page
+    table, so memory use grows with the number of pages written rather than with the largest address.
+*/
+class BackingMemory
+{
+public:
+    BackingMemory() : last_page_number(0), last_page(NULL) {}
+
+    BackingMemory(const BackingMemory &) = delete;
+    BackingMemory &operator=(const BackingMemory &) = delete;
+
+    long long int read(uint64_t address)
+    {
+        long long int *page = find_page(address >> BACKING_PAGE_BITS);
+        return page != NULL ? page[address & (BACKING_PAGE_BLOCKS - 1)] : (long long int)address;
+    }
+
+    void write(uint64_t address, long long int data)
+    {
+        uint64_t page_number = address >> BACKING_PAGE_BITS;
+        long long int *page = find_page(page_number);
+        if (page == NULL)
+        {
+            page = allocate_page(page_number);
+        }
+        page[address & (BACKING_PAGE_BLOCKS - 1)] = data;
+    }
+
+    size_t allocated_pages() const
+    {
+        return pages.size();
+    }
+
+    // the allocated pages in address order
+    void save(SnapshotWriter &out) const
+    {
+        std::vector<uint64_t> page_numbers;
+        for (auto &page : pages)
+        {
+            page_numbers.push_back(page.first);
+        }
+        std::sort(page_numbers.begin(), page_numbers.end());
+
+        out.write_value((uint64_t)page_numbers.size());
+        for (uint64_t page_number : page_numbers)
+        {
+            out.write_value(page_number);
+            out.write(pages.at(page_number).get(), BACKING_PAGE_BLOCKS * sizeof(long long int));
+        }
+    }
+
+    // replace the contents by those of a snapshot
+    void load(SnapshotReader &in)
+    {
+        pages.clear();
+        last_page = NULL;
+
+        uint64_t page_count;
+        in.read_value(page_count);
+        for (uint64_t p = 0; p < page_count && in.ok(); p++)
+        {
+            uint64_t page_number;
+            in.read_value(page_number);
+            in.read(allocate_page(page_number), BACKING_PAGE_BLOCKS * sizeof(long long int));
+        }
+    }
+
+private:
+    long long int *find_page(uint64_t page_number)
+    {
+        if (last_page != NULL && last_page_number == page_number)
+        {
+            return last_page;
+        }
+
+        auto it = pages.find(page_number);
+        if (it == pages.end())
+        {
+            return NULL;
+        }
+        last_page_number = page_number;
+        last_page = it->second.get();
+        return last_page;
+    }
+
+    long long int *allocate_page(uint64_t page_number)
+    {
+        long long int *page = new long long int[BACKING_PAGE_BLOCKS];
+        uint64_t first_block = page_number << BACKING_PAGE_BITS;
+        for (int i = 0; i < BACKING_PAGE_BLOCKS; i++)
+        {
+            page[i] = (long long int)(first_block + i);
+        }
+        pages[page_number].reset(page);
+
+        last_page_number = page_number;
+        last_page = page;
+        return page;
+    }
+
+    std::unordered_map<uint64_t, std::unique_ptr<long long int[]>> pages;
+    uint64_t last_page_number;
+    long long int *last_page;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include "../cache_sets.h"
+
+using namespace std;
+
+/*
+    Microbenchmark of the set search in cache_sets.h against the per-line loops it replaced. Sets are spread over a
+    few MB, so the numbers include fetching the set from the cache hierarchy as a real access does.
+
+    build: g++ -O2 -march=native -o lookup_benchmark benchmark/lookup_benchmark.cpp
+*/
+
+#define BENCH_SETS 4096
+#define BENCH_QUERIES 4000000
+
+// lookup as the original per-line loop: first valid line with the tag, first invalid line until then
+static inline int lookup_loop(const CacheSet &set, int ways, uint64_t tag, int &first_non_valid_index)
+{
+    first_non_valid_index = -1;
+    for (int i = 0; i < ways; i++)
+    {
+        if (test_bit(set.valid, i))
+        {
+            if (set.tag[i] == tag)
+            {
+                return i;
+            }
+        }
+        else if (first_non_valid_index == -1)
+        {
+            first_non_valid_index = i;
+        }
+    }
+    return -1;
+}
+
+static inline int lookup_mask(const CacheSet &set, int ways, uint64_t tag, int &first_non_valid_index)
+{
+    int hit_index = find_line(set, ways, tag);
+    first_non_valid_index = hit_index == -1 ? find_invalid_line(set, ways) : -1;
+    return hit_index;
+}
+
+// victim search as the original min-scan
+static inline int victim_loop(const long long int *access_time, int begin, int end, long long int inst_count)
+{
+    long long int least_recent_time = inst_count + 1;
+    int LRU_index = 0;
+    for (int i = begin; i < end; i++)
+    {
+        if (access_time[i] < least_recent_time)
+        {
+            least_recent_time = access_time[i];
+            LRU_index = i;
+        }
+    }
+    return LRU_index;
+}
+
+template <class F>
+double time_per_query(F f)
+{
+    auto start = chrono::steady_clock::now();
+    f();
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / BENCH_QUERIES;
+}
+
+int main()
+{
+    mt19937_64 rng(42);
+    cout << "ways, lookup_loop_ns, lookup_mask_ns, lookup_speedup, victim_loop_ns, victim_ns, victim_speedup" << endl;
+
+    for (int ways : {4, 8, 16, 32, 64, 128})
+    {
+        CacheSets cache(BENCH_SETS, ways);
+        for (int s = 0; s < BENCH_SETS; s++)
+        {
+            CacheSet set = cache.set(s);
+            for (int i = 0; i < ways; i++)
+            {
+                set.tag[i] = rng() % (4 * ways);
+                set.access_time[i] = rng() % 1000000;
+                assign_bit(set.valid, i, rng() % 8 != 0);
+            }
+        }
+
+        vector<int> query_set(BENCH_QUERIES);
+        vector<uint64_t> query_tag(BENCH_QUERIES);
+        for (int q = 0; q < BENCH_QUERIES; q++)
+        {
+            query_set[q] = rng() % BENCH_SETS;
+            query_tag[q] = rng() % (4 * ways);
+        }
+
+        long long int checksum_loop = 0, checksum_simd = 0;
+        double lookup_loop_ns = time_per_query([&]()
+                                               {
+                                                   for (int q = 0; q < BENCH_QUERIES; q++)
+                                                   {
+                                                       int first_non_valid_index;
+                                                       int hit_index = lookup_loop(cache.set(query_set[q]), ways, query_tag[q], first_non_valid_index);
+                                                       checksum_loop += hit_index != -1 ? hit_index : ways + first_non_valid_index;
+                                                   }
+                                               });
+        double lookup_simd_ns = time_per_query([&]()
+                                               {
+                                                   for (int q = 0; q < BENCH_QUERIES; q++)
+                                                   {
+                                                       int first_non_valid_index;
+                                                       int hit_index = lookup_mask(cache.set(query_set[q]), ways, query_tag[q], first_non_valid_index);
+                                                       checksum_simd += hit_index != -1 ? hit_index : ways + first_non_valid_index;
+                                                   }
+                                               });
+        if (checksum_loop != checksum_simd)
+        {
+            cout << "lookup mismatch at " << ways << " ways" << endl;
+            return 1;
+        }
+
+        checksum_loop = checksum_simd = 0;
+        double victim_loop_ns = time_per_query([&]()
+                                               {
+                                                   for (int q = 0; q < BENCH_QUERIES; q++)
+                                                   {
+                                                       int begin = query_tag[q] % ways;
+                                                       checksum_loop += victim_loop(cache.set(query_set[q]).access_time, begin, ways, 1000000);
+                                                   }
+                                               });
+        double victim_simd_ns = time_per_query([&]()
+                                               {
+                                                   for (int q = 0; q < BENCH_QUERIES; q++)
+                                                   {
+                                                       int begin = query_tag[q] % ways;
+                                                       checksum_simd += least_recent_line(cache.set(query_set[q]).access_time, begin, ways);
+                                                   }
+                                               });
+        if (checksum_loop != checksum_simd)
+        {
+            cout << "victim mismatch at " << ways << " ways" << endl;
+            return 1;
+        }
+
+        cout << ways << ", " << lookup_loop_ns << ", " << lookup_simd_ns << ", " << lookup_loop_ns / lookup_simd_ns << ", "
+             << victim_loop_ns << ", " << victim_simd_ns << ", " << victim_loop_ns / victim_simd_ns << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,372 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "../trace_reader.h"
+#include "../cache.h"
+
+using namespace std;
+
+/*
+    Throughput regression benchmark of the simulator. For every trace profile it measures, each in a child process
+    so that the peak RSS belongs to one phase only:
+
+        parse             streaming the text trace through TextTraceReader
+        simulate          Cache::access over the trace, loaded into memory beforehand (not timed; its memory is
+                          included in the peak RSS), for every cache geometry, with the Cache CacheSimulator picks
+                          (with_associativity(): specialized for its associativity with -DCACHE_SPECIALIZE=1)
+        simulate_generic  the same with the generic Cache, whose associativity is only known at run time
+
+    The best of --repeat runs is reported as accesses/s and ns/access, as CSV. With --baseline, ns/access are compared
+    against the CSV of an earlier build, and the exit status is 1 if any is slower by more than --tolerance.
+
+    build: g++ -O2 -march=native -o throughput_benchmark benchmark/throughput_benchmark.cpp
+           (add -DCACHE_SPECIALIZE=1 to compare the specialized Caches with the generic one)
+    run:   ./throughput_benchmark [--accesses n] [--repeat r] [--trace-dir dir] [--output results.csv]
+                                  [--baseline previous.csv] [--tolerance 0.1]
+           from the repository root, so that the traces of input/ are found
+*/
+
+#define BENCH_ACCESSES 1000000 // accesses per generated trace
+#define BENCH_REPEAT 3
+#define BENCH_SEED 42
+
+struct Geometry
+{
+    int cache_size;
+    int cache_block_size;
+    int cache_associativity;
+    int T;
+};
+
+// 256 sets x 4 ways, 1024 sets x 16 ways, 1024 sets x 64 ways
+static const Geometry geometries[] = {{1024, 1, 4, 16}, {16384, 1, 16, 64}, {65536, 1, 64, 256}};
+
+struct Profile
+{
+    const char *name;
+    const char *file; // existing trace, or NULL to generate one
+};
+
+static const Profile profiles[] = {
+    {"read_heavy", NULL},
+    {"write_heavy", NULL},
+    {"hot_set", NULL},
+    {"streaming", NULL},
+    {"inp_gen_large0", "input/inp_gen_large0.txt"},
+    {"inp_gen_obs", "input/inp_gen_obs.txt"},
+    {"inp_gen_large_writes", "input/inp_gen_large_writes.txt"},
+};
+
+// write a synthetic text trace of the named profile
+void generate_trace(const string &name, const string &filename, long long int accesses)
+{
+    FILE *file = fopen(filename.c_str(), "w");
+    if (file == NULL)
+    {
+        cout << "Could not open " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    mt19937_64 rng(BENCH_SEED);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    fprintf(file, "1024\n1\n4\n16\n");
+    for (long long int i = 0; i < accesses; i++)
+    {
+        uint64_t address;
+        double write_fraction;
+        if (name == "streaming")
+        {
+            address = i; // every block once
+            write_fraction = 0.3;
+        }
+        else if (name == "hot_set")
+        {
+            address = (rng() % 512) * 4096; // 512 blocks in the same set of every geometry
+            write_fraction = 0.3;
+        }
+        else
+        {
+            address = (uint64_t)(16.0 / pow(1.0 - uniform(rng), 1.0 / 0.8)) % (1 << 20); // heavy tailed reuse
+            write_fraction = name == "write_heavy" ? 0.7 : 0.1;
+        }
+
+        if (uniform(rng) < write_fraction)
+        {
+            fprintf(file, "%llu, W, %lld\n", (unsigned long long)address, i);
+        }
+        else
+        {
+            fprintf(file, "%llu, R\n", (unsigned long long)address);
+        }
+    }
+    fclose(file);
+}
+
+// run f in a child process; returns the seconds it reports and sets the peak RSS of the child
+template <class F>
+double measure_in_child(F f, long &peak_rss_kb)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        cout << "pipe failed" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        double seconds = f();
+        if (write(fds[1], &seconds, sizeof(seconds)) != sizeof(seconds))
+        {
+            _exit(EXIT_FAILURE);
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(fds[1]);
+    double seconds = -1;
+    if (read(fds[0], &seconds, sizeof(seconds)) != sizeof(seconds))
+    {
+        seconds = -1;
+    }
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if (seconds < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        cout << "benchmark child failed" << endl;
+        exit(EXIT_FAILURE);
+    }
+    peak_rss_kb = usage.ru_maxrss;
+    return seconds;
+}
+
+double parse_seconds(const string &filename, long long int &accesses)
+{
+    auto start = chrono::steady_clock::now();
+    TextTraceReader trace(filename.c_str());
+    int cache_size, cache_block_size, cache_associativity, T;
+    trace.read_header(cache_size, cache_block_size, cache_associativity, T);
+
+    Access access;
+    long long int count = 0, checksum = 0;
+    while (trace.next(access))
+    {
+        count++;
+        checksum += access.address;
+    }
+    auto end = chrono::steady_clock::now();
+
+    accesses = count;
+    if (checksum == -1)
+    {
+        cout << endl; // keep the loop from being optimized away
+    }
+    return chrono::duration<double>(end - start).count();
+}
+
+double simulate_seconds(const string &filename, const Geometry &geometry, bool generic)
+{
+    TextTraceReader trace(filename.c_str());
+    int cache_size, cache_block_size, cache_associativity, T;
+    trace.read_header(cache_size, cache_block_size, cache_associativity, T);
+
+    vector<Access> accesses;
+    Access access;
+    while (trace.next(access))
+    {
+        accesses.push_back(access);
+    }
+
+    int total_sets = geometry.cache_size / geometry.cache_block_size / geometry.cache_associativity;
+    double seconds = 0;
+    auto simulate = [&](auto ways)
+    {
+        auto start = chrono::steady_clock::now();
+        Cache<PriorityLruPolicy, decltype(ways)::value> cache(total_sets, geometry.cache_associativity, geometry.T);
+        for (size_t i = 0; i < accesses.size(); i++)
+        {
+            cache.access(accesses[i], i);
+        }
+        auto end = chrono::steady_clock::now();
+
+        if (cache.stats.read_hits == -1)
+        {
+            cout << endl;
+        }
+        seconds = chrono::duration<double>(end - start).count();
+    };
+    if (generic)
+    {
+        simulate(WaysType<0>());
+    }
+    else
+    {
+        with_associativity(geometry.cache_associativity, simulate);
+    }
+    return seconds;
+}
+
+string geometry_name(const Geometry &geometry)
+{
+    return to_string(geometry.cache_size) + "/" + to_string(geometry.cache_block_size) + "/" + to_string(geometry.cache_associativity) + "/" + to_string(geometry.T);
+}
+
+// ns per access of an earlier run by "profile, geometry, phase"
+map<string, double> read_baseline(const char *filename)
+{
+    map<string, double> baseline;
+    ifstream file(filename);
+    if (!file)
+    {
+        cout << "Could not open " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    string line;
+    getline(file, line); // header
+    while (getline(file, line))
+    {
+        vector<string> fields;
+        stringstream fields_stream(line);
+        string field;
+        while (getline(fields_stream, field, ','))
+        {
+            fields.push_back(field.substr(field.find_first_not_of(' ')));
+        }
+        if (fields.size() >= 7)
+        {
+            baseline[fields[0] + ", " + fields[1] + ", " + fields[2]] = atof(fields[6].c_str());
+        }
+    }
+    return baseline;
+}
+
+int main(int argc, char **argv)
+{
+    long long int generated_accesses = BENCH_ACCESSES;
+    int repeat = BENCH_REPEAT;
+    string trace_dir = "/tmp";
+    const char *output = NULL;
+    const char *baseline_file = NULL;
+    double tolerance = 0.1;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (i + 1 < argc && arg == "--accesses")
+        {
+            generated_accesses = atoll(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--repeat")
+        {
+            repeat = max(1, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--trace-dir")
+        {
+            trace_dir = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--output")
+        {
+            output = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--baseline")
+        {
+            baseline_file = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--tolerance")
+        {
+            tolerance = atof(argv[++i]);
+        }
+        else
+        {
+            cout << "Unknown argument: " << arg << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    map<string, double> baseline;
+    if (baseline_file != NULL)
+    {
+        baseline = read_baseline(baseline_file);
+    }
+
+    ofstream output_file;
+    if (output != NULL)
+    {
+        output_file.open(output);
+    }
+    ostream &results = output != NULL ? output_file : cout;
+    results << "profile, geometry, phase, accesses, seconds, accesses_per_second, ns_per_access, peak_rss_kb" << endl;
+
+    vector<string> regressions;
+    for (const Profile &profile : profiles)
+    {
+        string filename = profile.file != NULL ? profile.file : trace_dir + "/bench_" + profile.name + ".txt";
+        if (profile.file == NULL)
+        {
+            generate_trace(profile.name, filename, generated_accesses);
+        }
+        else if (access(filename.c_str(), R_OK) != 0)
+        {
+            cerr << "Skipping " << profile.name << ": " << filename << " not found" << endl;
+            continue;
+        }
+
+        // accesses of the trace, counted by the parse phase
+        long long int accesses = 0;
+        parse_seconds(filename, accesses);
+
+        // phase -1 parses, then every geometry is simulated specialized (even phase) and generic (odd phase)
+        for (int phase = -1; phase < 2 * (int)(sizeof(geometries) / sizeof(geometries[0])); phase++)
+        {
+            bool parse = phase == -1;
+            int g = phase / 2;
+            bool generic = phase % 2 == 1;
+            double best = 0;
+            long peak_rss_kb = 0;
+            for (int r = 0; r < repeat; r++)
+            {
+                long rss_kb;
+                double seconds = measure_in_child([&]()
+                                                  {
+                                                      long long int ignored;
+                                                      return parse ? parse_seconds(filename, ignored) : simulate_seconds(filename, geometries[g], generic);
+                                                  },
+                                                  rss_kb);
+                best = r == 0 ? seconds : min(best, seconds);
+                peak_rss_kb = max(peak_rss_kb, rss_kb);
+            }
+
+            string key = string(profile.name) + ", " + (parse ? "-" : geometry_name(geometries[g])) + ", " +
+                         (parse ? "parse" : generic ? "simulate_generic" : "simulate");
+            double ns_per_access = best * 1e9 / accesses;
+            results << key << ", " << accesses << ", " << best << ", " << (long long int)(accesses / best) << ", " << ns_per_access << ", " << peak_rss_kb << endl;
+
+            auto previous = baseline.find(key);
+            if (previous != baseline.end() && ns_per_access > previous->second * (1 + tolerance))
+            {
+                regressions.push_back(key + ": " + to_string(previous->second) + " -> " + to_string(ns_per_access) + " ns/access");
+            }
+        }
+    }
+
+    for (const string &regression : regressions)
+    {
+        cerr << "REGRESSION " << regression << endl;
+    }
+    return regressions.empty() ? 0 : 1;
+}
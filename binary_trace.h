@@ -0,0 +1,386 @@
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace_reader.h"
+
+/*
+    Packed binary trace format (all integers little-endian):
+
+        header (32 bytes):
+            char     magic[4]              "CSTR"
+            uint32_t version               BINARY_TRACE_VERSION
+            int32_t  cache_size
+            int32_t  cache_block_size
+            int32_t  cache_associativity
+            int32_t  T
+            uint64_t record_count
+
+        blocks, each holding up to BINARY_TRACE_BLOCK_RECORDS records:
+            uint32_t payload_bytes
+            uint32_t records
+            payload
+
+        record:
+            varint   zigzag(address - previous address) << 1 | (type == W), a 65-bit value
+            varint   zigzag(data)          (W only)
+
+    The previous address starts at 0 in every block, so blocks can be decoded independently. Address differences
+    are taken modulo 2^64, so every 64-bit address is representable; version 1 wrote the first varint as 64 bits,
+    which lost the top bit of differences of 2^62 and more, and is otherwise read the same.
+*/
+
+#define BINARY_TRACE_MAGIC "CSTR"
+#define BINARY_TRACE_VERSION 2
+#define BINARY_TRACE_MIN_VERSION 1 // oldest version still read
+#define BINARY_TRACE_HEADER_SIZE 32
+#define BINARY_TRACE_BLOCK_HEADER_SIZE 8
+#define BINARY_TRACE_BLOCK_RECORDS 65536
+
+static inline uint64_t zigzag_encode(long long int value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline long long int zigzag_decode(uint64_t value)
+{
+    return (long long int)(value >> 1) ^ -(long long int)(value & 1);
+}
+
+static inline void put_varint(std::vector<unsigned char> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+// varint of the 65-bit value high:low (high is its bit 64)
+static inline void put_varint65(std::vector<unsigned char> &out, uint64_t low, bool high)
+{
+    while (low >= 0x80 || high)
+    {
+        out.push_back((unsigned char)(low | 0x80));
+        low = (low >> 7) | ((uint64_t)high << 57);
+        high = false;
+    }
+    out.push_back((unsigned char)low);
+}
+
+// false if the varint runs past end or does not fit in 65 bits
+static inline bool get_varint65(const unsigned char *&p, const unsigned char *end, uint64_t &low, bool &high)
+{
+    low = 0;
+    high = false;
+    for (int shift = 0; shift < 70 && p < end; shift += 7)
+    {
+        unsigned char byte = *p++;
+        low |= (uint64_t)(byte & 0x7f) << shift;
+        if (shift == 63)
+        {
+            if ((byte & 0x7f) > 3)
+            {
+                return false;
+            }
+            high = (byte & 0x7f) >> 1;
+        }
+        if (byte < 0x80)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// false if the varint runs past end
+static inline bool get_varint(const unsigned char *&p, const unsigned char *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        unsigned char byte = *p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void put_u32(unsigned char *out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static inline uint32_t get_u32(const unsigned char *in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static inline uint64_t get_u64(const unsigned char *in)
+{
+    return (uint64_t)get_u32(in) | ((uint64_t)get_u32(in + 4) << 32);
+}
+
+// true if filename is a regular file starting with the binary trace magic
+static inline bool is_binary_trace(const char *filename)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+
+    char magic[4];
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool binary = fread(magic, 1, 4, file) == 4 && memcmp(magic, BINARY_TRACE_MAGIC, 4) == 0;
+    fclose(file);
+    return binary;
+}
+
+class BinaryTraceWriter
+{
+public:
+    BinaryTraceWriter(const char *filename, int cache_size, int cache_block_size, int cache_associativity, int T)
+        : record_count(0), block_records(0), previous_address(0)
+    {
+        file = fopen(filename, "wb");
+        if (file == NULL)
+        {
+            std::cout << "Could not open " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        unsigned char header[BINARY_TRACE_HEADER_SIZE] = {0};
+        memcpy(header, BINARY_TRACE_MAGIC, 4);
+        put_u32(header + 4, BINARY_TRACE_VERSION);
+        put_u32(header + 8, cache_size);
+        put_u32(header + 12, cache_block_size);
+        put_u32(header + 16, cache_associativity);
+        put_u32(header + 20, T);
+        fwrite(header, 1, BINARY_TRACE_HEADER_SIZE, file);
+    }
+
+    ~BinaryTraceWriter()
+    {
+        close();
+    }
+
+    void write(const Access &access)
+    {
+        if (access.core != 0)
+        {
+            std::cout << "Core ids are not supported by the binary trace format" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        uint64_t delta = zigzag_encode((long long int)(access.address - previous_address));
+        put_varint65(block, delta << 1 | (access.type == W), delta >> 63);
+        if (access.type == W)
+        {
+            put_varint(block, zigzag_encode(access.data));
+        }
+        previous_address = access.address;
+        record_count++;
+
+        if (++block_records == BINARY_TRACE_BLOCK_RECORDS)
+        {
+            flush_block();
+        }
+    }
+
+    // flush the last block and fill in the record count
+    void close()
+    {
+        if (file == NULL)
+        {
+            return;
+        }
+        flush_block();
+
+        unsigned char count[8];
+        put_u32(count, (uint32_t)record_count);
+        put_u32(count + 4, (uint32_t)(record_count >> 32));
+        fseek(file, 24, SEEK_SET);
+        fwrite(count, 1, 8, file);
+        fclose(file);
+        file = NULL;
+    }
+
+    uint64_t records() const
+    {
+        return record_count;
+    }
+
+private:
+    void flush_block()
+    {
+        if (block_records == 0)
+        {
+            return;
+        }
+
+        unsigned char block_header[BINARY_TRACE_BLOCK_HEADER_SIZE];
+        put_u32(block_header, (uint32_t)block.size());
+        put_u32(block_header + 4, block_records);
+        fwrite(block_header, 1, BINARY_TRACE_BLOCK_HEADER_SIZE, file);
+        fwrite(block.data(), 1, block.size(), file);
+
+        block.clear();
+        block_records = 0;
+        previous_address = 0;
+    }
+
+    FILE *file;
+    std::vector<unsigned char> block;
+    uint64_t record_count;
+    uint32_t block_records;
+    uint64_t previous_address;
+};
+
+// Memory-mapped reader for the binary trace format, same interface as TextTraceReader.
+class BinaryTraceReader
+{
+public:
+    BinaryTraceReader(const char *filename)
+        : mapping(NULL), mapping_size(0), cursor(NULL), end(NULL), block_end(NULL), block_records(0), previous_address(0)
+    {
+        int fd = open(filename, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            std::cout << "Could not open " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (st.st_size < BINARY_TRACE_HEADER_SIZE)
+        {
+            corrupt_trace();
+        }
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+        {
+            std::cout << "Could not map " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+        mapping = (const unsigned char *)addr;
+        mapping_size = st.st_size;
+        if (memcmp(mapping, BINARY_TRACE_MAGIC, 4) != 0 || get_u32(mapping + 4) < BINARY_TRACE_MIN_VERSION ||
+            get_u32(mapping + 4) > BINARY_TRACE_VERSION)
+        {
+            corrupt_trace();
+        }
+        cursor = mapping + BINARY_TRACE_HEADER_SIZE;
+        end = mapping + mapping_size;
+        block_end = cursor;
+    }
+
+    ~BinaryTraceReader()
+    {
+        munmap((void *)mapping, mapping_size);
+    }
+
+    void read_header(int &cache_size, int &cache_block_size, int &cache_associativity, int &T)
+    {
+        cache_size = (int)get_u32(mapping + 8);
+        cache_block_size = (int)get_u32(mapping + 12);
+        cache_associativity = (int)get_u32(mapping + 16);
+        T = (int)get_u32(mapping + 20);
+    }
+
+    uint64_t records() const
+    {
+        return get_u64(mapping + 24);
+    }
+
+    bool next(Access &access)
+    {
+        while (block_records == 0)
+        {
+            if (cursor != block_end)
+            {
+                corrupt_trace(); // payload longer than its records
+            }
+            if (cursor == end)
+            {
+                return false;
+            }
+            if (end - cursor < BINARY_TRACE_BLOCK_HEADER_SIZE)
+            {
+                corrupt_trace();
+            }
+
+            uint32_t payload_bytes = get_u32(cursor);
+            block_records = get_u32(cursor + 4);
+            cursor += BINARY_TRACE_BLOCK_HEADER_SIZE;
+            if ((uint64_t)(end - cursor) < payload_bytes)
+            {
+                corrupt_trace();
+            }
+            block_end = cursor + payload_bytes;
+            previous_address = 0;
+        }
+
+        uint64_t value;
+        bool high;
+        if (!get_varint65(cursor, block_end, value, high))
+        {
+            corrupt_trace();
+        }
+        uint64_t address = previous_address + (uint64_t)zigzag_decode(value >> 1 | (uint64_t)high << 63);
+        access.address = address;
+        access.type = (value & 1) ? W : R;
+        access.data = 0;
+        access.core = 0;
+        access.repeat = 1;
+        if (access.type == W)
+        {
+            if (!get_varint(cursor, block_end, value))
+            {
+                corrupt_trace();
+            }
+            access.data = zigzag_decode(value);
+        }
+        previous_address = address;
+        block_records--;
+        return true;
+    }
+
+private:
+    void corrupt_trace()
+    {
+        std::cout << "Corrupt binary trace" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const unsigned char *mapping;
+    size_t mapping_size;
+    const unsigned char *cursor;
+    const unsigned char *end;
+    const unsigned char *block_end;
+    uint32_t block_records;
+    uint64_t previous_address;
+};
+
+#endif
@@ -0,0 +1,957 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+#include <stdint.h>
+#include <math.h>
+#include "trace_reader.h"
+#include "cache_stats.h"
+#include "cache_sets.h"
+#include "backing_memory.h"
+#include "replacement_policy.h"
+#include "coherence.h"
+#include "victim_cache.h"
+
+#ifndef DEBUG
+#define DEBUG 0
+#endif
+
+// check validity of number (should be exponent of 2)
+static inline bool check_validity(int n)
+{
+    if (n == 0)
+        return false;
+
+    return ceil(log2(n)) == floor(log2(n));
+}
+
+// check that the cache geometry is usable
+static inline bool check_parameters(int cache_size, int cache_block_size, int cache_associativity)
+{
+    if (!(check_validity(cache_size) && check_validity(cache_block_size) && check_validity(cache_associativity)))
+    {
+        return false;
+    }
+
+    int total_cache_blocks = cache_size / cache_block_size;
+    int total_sets = total_cache_blocks / cache_associativity;
+
+    return total_cache_blocks >= 1 && total_sets >= 1;
+}
+
+// build with -DCACHE_SPECIALIZE=1 to also compile the Caches specialized on their associativity. They are off by
+// default: their gain is within measurement noise (see benchmark/throughput_benchmark.cpp), and they multiply the
+// compile time of cache_simulator.cpp by about 4 and its object size by about 5
+#ifndef CACHE_SPECIALIZE
+#define CACHE_SPECIALIZE 0
+#endif
+
+// associativities Cache is specialized for (see with_associativity()); the others use the generic Cache<Policy, 0>
+template <int N>
+struct WaysType
+{
+    static const int value = N;
+};
+
+// call f(WaysType<N>()) with N the associativity if Cache is specialized for it, 0 otherwise
+template <class F>
+void with_associativity(int associativity, F f)
+{
+    switch (associativity)
+    {
+#if CACHE_SPECIALIZE
+    case 1:
+        f(WaysType<1>());
+        break;
+    case 2:
+        f(WaysType<2>());
+        break;
+    case 4:
+        f(WaysType<4>());
+        break;
+    case 8:
+        f(WaysType<8>());
+        break;
+    case 16:
+        f(WaysType<16>());
+        break;
+    case 32:
+        f(WaysType<32>());
+        break;
+    case 64:
+        f(WaysType<64>());
+        break;
+#endif
+    default:
+        f(WaysType<0>());
+        break;
+    }
+}
+
+// inclusion of a lower level towards the levels above it
+#define INCLUSION_NINE 0      // non-inclusive non-exclusive: filled on misses, no back-invalidation
+#define INCLUSION_INCLUSIVE 1 // filled on misses, evictions invalidate the copies above
+#define INCLUSION_EXCLUSIVE 2 // holds only victims of the level above; a hit hands the line up
+
+// when the writes of the first level reach the next one (see Cache::set_write_policy())
+#define WRITE_BACK 0    // with the dirty line, when it is evicted
+#define WRITE_THROUGH 1 // at once; lines are never dirty
+
+
+/*
+    Write back, write allocate cache in front of a sparse main memory or of the next level of a hierarchy (the first
+    level of a hierarchy can also write through and not allocate on write misses, see set_write_policy()).
+    Replacement is done by Policy (see replacement_policy.h); the default is the HIGH and LOW PRIORITY groups described
+    in the README.
+
+    total_sets is a power of 2, so the set index and the tag of an address are decoded with a mask and a shift.
+    A Cache can hold only the sets [first_set, first_set + set_count) of a cache with total_sets sets. Sets never
+    interact, so disjoint ranges of one cache can be simulated independently as long as every access is stamped with
+    its sequence number in the full trace.
+
+    Levels of a hierarchy are chained with attach(). Addresses are always block addresses of the first level, and a
+    line of a lower level holds block_words of those blocks, one data word each. Only the first level sees the trace
+    (access()); it forwards misses with fetch() and dirty victims with write_back(), and a lower level does the same
+    towards its own next level. Every operation is stamped with the sequence number of the trace access that caused
+    it, so T is counted in trace accesses at every level.
+
+    The first level caches of several cores can share a next level and be kept coherent by a CoherenceBus (join()),
+    which snoops the other caches on misses and on writes to shared lines.
+
+    Ways, if it is not 0, is the associativity, known at compile time: the set searches then have constant trip
+    counts and are unrolled. with_associativity() picks the instantiation of a run-time associativity (the generic
+    one unless built with CACHE_SPECIALIZE=1).
+
+    enable_profile() adds 3C miss classification and per-set counters (see cache_profile.h). Its hooks cost one
+    branch per access when profiling is off and are compiled out with CACHE_PROFILE=0.
+
+    The first level can also be filled by a prefetcher (prefetch(), see prefetcher.h); enable_prefetch() tags the
+    prefetched lines until their first demand access or their eviction. enable_victim_cache() puts a VictimCache
+    behind it (single core only: snoops do not look into it).
+*/
+template <class Policy = PriorityLruPolicy, int Ways = 0>
+class Cache
+{
+public:
+    Cache(int total_sets, int associativity, int T, int first_set = 0, int set_count = -1, int block_words = 1)
+        : stats(), prefetch_uses(0), prefetch_unused(0), total_sets(total_sets), set_mask(total_sets - 1), set_bits(__builtin_ctz(total_sets)), associativity(associativity),
+          first_set(first_set), block_words(block_words),
+          block_shift(__builtin_ctz(block_words)), inclusion(INCLUSION_NINE), next_level(NULL), previous_level(NULL),
+          bus(NULL), core(0), lines(set_count < 0 ? total_sets : set_count, associativity, block_words), main_memory(&own_memory),
+          policy(lines, T), T(T), write_policy(WRITE_BACK), write_allocate(true), returned_dirty(false), prefetching(false)
+    {
+    }
+
+    // put next in front of main memory, below this cache; inclusion is the relation of next to the levels above it
+    void attach(Cache *next, int inclusion)
+    {
+        next_level = next;
+        next->previous_level = this;
+        next->inclusion = inclusion;
+    }
+
+    // take part in the coherence protocol of bus as its next core
+    void join(CoherenceBus<Policy> *bus)
+    {
+        this->bus = bus;
+        core = bus->attach(this);
+    }
+
+    // WRITE_BACK or WRITE_THROUGH; without write_allocate, a write miss only updates the next level. A write miss always
+    // writes its data to the next level, before the line is filled from it if it is allocated.
+    void set_write_policy(int write_policy, bool write_allocate)
+    {
+        this->write_policy = write_policy;
+        this->write_allocate = write_allocate;
+    }
+
+    /*
+        Tag the lines filled by prefetch() from now on. The first demand access to a tagged line counts in
+        prefetch_uses and is not a reuse for the policy: the line stays where its fill put it (the LOW PRIORITY group
+        for priority-lru), as after a demand miss, and only a second access promotes it. Tagged lines that are evicted
+        or invalidated first count in prefetch_unused.
+    */
+    void enable_prefetch()
+    {
+        prefetching = true;
+    }
+
+    // keep the lines evicted from this level in a victim cache of entries lines
+    void enable_victim_cache(int entries)
+    {
+        victims.reset(new VictimCache(entries, block_words));
+        returned_line.resize(block_words);
+    }
+
+    // NULL unless enable_victim_cache() was called
+    const VictimCache *victim_cache() const
+    {
+        return victims.get();
+    }
+
+    // use the main memory of other (last levels of several cores without a shared level)
+    void share_main_memory(Cache *other)
+    {
+        main_memory = other->main_memory;
+    }
+
+    // start collecting a CacheProfile of the following accesses
+    void enable_profile()
+    {
+        profiler.reset(new CacheProfile(lines.sets(), associativity));
+        policy.count_demotions(profiler->set_demotions.data());
+    }
+
+    // NULL unless enable_profile() was called
+    const CacheProfile *profile() const
+    {
+        return profiler.get();
+    }
+
+    // true if block address belongs to one of the sets held by this cache
+    bool holds(uint64_t memory_address) const
+    {
+        int set_index = (memory_address >> block_shift) & set_mask;
+        return set_index >= first_set && set_index < first_set + lines.sets();
+    }
+
+    // true if the line of block address is cached
+    bool cached(uint64_t memory_address)
+    {
+        int set_index = (memory_address >> block_shift) & set_mask;
+        return find_line(lines.set(set_index - first_set), ways(), memory_address >> block_shift >> set_bits) != -1;
+    }
+
+    // simulate one access; inst_count is its sequence number in the trace and is used as its timestamp. The data read
+    // by an R access is stored in read_value if it is set. A coalesced record (repeat > 1) is simulated as its repeat
+    // accesses, numbered from inst_count; the result and the data read are those of the first one.
+    int access(const Access &inst, long long int inst_count, long long int *read_value = NULL)
+    {
+        // policy updates due before this access (only pending if other sets were accessed in between)
+        policy.advance(inst_count - 1);
+
+        uint64_t memory_address = inst.address; // this is block address
+        int inst_type = inst.type;
+
+        /*
+            byte address:   <tag><set_index><offset>
+            block address:  <tag><set_index>
+        */
+
+        int set_index = (memory_address >> block_shift) & set_mask;
+        uint64_t tag = memory_address >> block_shift >> set_bits;
+        int word = memory_address & (block_words - 1);
+        int local_set_index = set_index - first_set;
+        CacheSet set = lines.set(local_set_index);
+
+        int hit_index = find_line(set, ways(), tag);
+        int hit_or_miss = hit_index != -1 ? HIT : MISS;
+        int first_non_valid_index = hit_or_miss == MISS ? find_invalid_line(set, ways()) : -1;
+#if CACHE_PROFILE
+        if (profiler)
+        {
+            profiler->access(local_set_index, memory_address >> block_shift, hit_or_miss == MISS);
+        }
+#endif
+
+#if DEBUG
+        std::cout << "first_non_valid_index: " << first_non_valid_index << std::endl;
+#endif
+
+        long long int read_result = 0;
+        long long int write_data = inst.data;
+        stats.accesses++;
+        if (inst_type == R)
+        {
+            stats.reads++;
+        }
+        else
+        {
+            // write back with write allocate
+#if DEBUG
+            test_memory.write(memory_address, write_data);
+#endif
+            stats.writes++;
+        }
+
+        if (hit_or_miss == HIT)
+        {
+            if (prefetching && prefetched.erase(memory_address - word))
+            {
+                // first use of a prefetched line, not a reuse (see enable_prefetch())
+                prefetch_uses++;
+            }
+            else
+            {
+                hit_index = policy.hit(set, local_set_index, hit_index, inst_count);
+            }
+            set.access_time[hit_index] = inst_count; // update accessed block time
+
+            if (inst_type == R)
+            {
+                stats.read_hits++;
+                read_result = set.data[hit_index * block_words + word];
+            }
+            else
+            {
+                stats.write_hits++;
+                if (bus != NULL && test_bit(set.shared, hit_index))
+                {
+                    // other cores may hold the line: invalidate their copies
+                    bus->upgrade(core, memory_address, inst_count);
+                    assign_bit(set.shared, hit_index, false);
+                }
+                set.data[hit_index * block_words + word] = write_data;
+                if (write_policy == WRITE_THROUGH)
+                {
+                    next_level_write(memory_address, 1, &write_data, true, false, inst_count);
+                }
+                else
+                {
+                    assign_bit(set.dirty, hit_index, true);
+                }
+            }
+        }
+        else
+        {
+            bool supplied = false, shared = false;
+            long long int supplied_data = 0;
+            if (bus != NULL)
+            {
+                supplied = bus->miss(core, memory_address, inst_type, supplied_data, shared, inst_count);
+            }
+
+            // a line that comes back from the victim cache leaves it before the victim of the fill takes its place,
+            // and a write miss on it is written after the fill
+            bool returned = (inst_type == R || write_allocate) && take_victim(memory_address - word);
+            if (inst_type == W && !returned)
+            {
+                // write to main memory (through the next level)
+                next_level_write(memory_address, 1, &write_data, true, false, inst_count);
+                if (victims)
+                {
+                    victims->update(memory_address - word, word, write_data);
+                }
+            }
+
+            if (inst_type == R || write_allocate)
+            {
+                int fill_index = first_non_valid_index;
+                if (fill_index == -1)
+                {
+                    // replacement: the policy picks the line to evict and the way for the new block
+                    fill_index = policy.victim(set, local_set_index, inst_count);
+                    evict(set, set_index, fill_index, inst_count);
+                }
+
+                // load from main memory (or the next level, or the cache of another core) to cache
+                fill(set, local_set_index, fill_index, tag, memory_address - word, inst_type, inst_count, supplied ? &supplied_data : NULL, shared, returned);
+                if (returned && inst_type == W)
+                {
+                    set.data[fill_index * block_words + word] = write_data;
+                    if (write_policy == WRITE_THROUGH)
+                    {
+                        next_level_write(memory_address, 1, &write_data, true, false, inst_count);
+                    }
+                    else
+                    {
+                        assign_bit(set.dirty, fill_index, true);
+                    }
+                }
+
+                read_result = set.data[fill_index * block_words + word];
+            }
+        }
+
+#if DEBUG
+        if (inst_type == R)
+        {
+            std::cout << "Read result: " << read_result << std::endl;
+            std::cout << "Read result from test_memory: " << test_memory.read(memory_address) << std::endl;
+            if (read_result == test_memory.read(memory_address))
+            {
+                std::cout << "Correct read!!" << std::endl;
+            }
+            else
+            {
+                std::cout << "Wrong read!!" << std::endl;
+            }
+        }
+#endif
+        if (read_value != NULL)
+        {
+            *read_value = read_result;
+        }
+
+        policy.accessed(local_set_index, inst_count);
+        if (inst.repeat > 1)
+        {
+            repeat_hits(inst, inst_count + 1);
+        }
+
+        return hit_or_miss;
+    }
+
+    /*
+        Prefetch of the line of block address at access inst_count: it is filled as a read miss, without counting as
+        an access of this level, unless it is already cached. Returns true if it was filled;
+        the block address of a valid line it evicted is then stored in victim (UINT64_MAX if there was none).
+    */
+    bool prefetch(uint64_t memory_address, long long int inst_count, uint64_t &victim)
+    {
+        policy.advance(inst_count - 1);
+
+        int set_index = (memory_address >> block_shift) & set_mask;
+        uint64_t tag = memory_address >> block_shift >> set_bits;
+        int word = memory_address & (block_words - 1);
+        int local_set_index = set_index - first_set;
+        CacheSet set = lines.set(local_set_index);
+
+        victim = UINT64_MAX;
+        if (find_line(set, ways(), tag) != -1)
+        {
+            return false;
+        }
+
+        bool returned = take_victim(memory_address - word);
+        int fill_index = find_invalid_line(set, ways());
+        if (fill_index == -1)
+        {
+            fill_index = policy.victim(set, local_set_index, inst_count);
+            victim = ((set.tag[fill_index] << set_bits) | set_index) << block_shift;
+            evict(set, set_index, fill_index, inst_count);
+        }
+        fill(set, local_set_index, fill_index, tag, memory_address - word, R, inst_count, NULL, false, returned);
+        if (prefetching)
+        {
+            prefetched.insert(memory_address - word);
+        }
+
+        policy.accessed(local_set_index, inst_count);
+        return true;
+    }
+
+    /*
+        Miss of the level above for its line of words blocks at address (aligned, at most block_words). Counted as an
+        access of the type of the trace access that missed. The data is copied to data; the result is true if it is
+        dirty, which only happens when an exclusive level hands its line up.
+    */
+    bool fetch(uint64_t address, int words, long long int *data, int type, long long int inst_count)
+    {
+        policy.advance(inst_count - 1);
+
+        int set_index = (address >> block_shift) & set_mask;
+        uint64_t tag = address >> block_shift >> set_bits;
+        int word = address & (block_words - 1);
+        int local_set_index = set_index - first_set;
+        CacheSet set = lines.set(local_set_index);
+
+        stats.accesses++;
+        if (type == R)
+        {
+            stats.reads++;
+        }
+        else
+        {
+            stats.writes++;
+        }
+
+        bool dirty = false;
+        int hit_index = find_line(set, ways(), tag);
+#if CACHE_PROFILE
+        if (profiler)
+        {
+            profiler->access(local_set_index, address >> block_shift, hit_index == -1);
+        }
+#endif
+        if (hit_index != -1)
+        {
+            if (type == R)
+            {
+                stats.read_hits++;
+            }
+            else
+            {
+                stats.write_hits++;
+            }
+            memcpy(data, set.data + hit_index * block_words + word, words * sizeof(long long int));
+
+            if (inclusion == INCLUSION_EXCLUSIVE)
+            {
+                // the line moves up
+                dirty = test_bit(set.dirty, hit_index);
+                invalidate_line(set, local_set_index, hit_index);
+            }
+            else
+            {
+                hit_index = policy.hit(set, local_set_index, hit_index, inst_count);
+                set.access_time[hit_index] = inst_count;
+            }
+        }
+        else if (inclusion == INCLUSION_EXCLUSIVE)
+        {
+            // not allocated here, the line only comes back as a victim of the level above
+            dirty = next_level_read(address, words, data, type, inst_count);
+        }
+        else
+        {
+            int fill_index = find_invalid_line(set, ways());
+            if (fill_index == -1)
+            {
+                fill_index = policy.victim(set, local_set_index, inst_count);
+                evict(set, set_index, fill_index, inst_count);
+            }
+            fill(set, local_set_index, fill_index, tag, address - word, type, inst_count);
+            memcpy(data, set.data + fill_index * block_words + word, words * sizeof(long long int));
+        }
+
+        policy.accessed(local_set_index, inst_count);
+        return dirty;
+    }
+
+    /*
+        Data of the level above for words blocks at address: a victim or the write of a write miss. A line that is
+        present is updated; otherwise the data is allocated if allocate is set (victims entering an exclusive level)
+        and passed on to the next level if it is dirty.
+    */
+    void write_back(uint64_t address, int words, const long long int *data, bool dirty, bool allocate, long long int inst_count)
+    {
+        policy.advance(inst_count - 1);
+
+        int set_index = (address >> block_shift) & set_mask;
+        uint64_t tag = address >> block_shift >> set_bits;
+        int word = address & (block_words - 1);
+        int local_set_index = set_index - first_set;
+        CacheSet set = lines.set(local_set_index);
+
+        int line_index = find_line(set, ways(), tag);
+        if (line_index == -1 && allocate)
+        {
+            line_index = find_invalid_line(set, ways());
+            if (line_index == -1)
+            {
+                line_index = policy.victim(set, local_set_index, inst_count);
+                evict(set, set_index, line_index, inst_count);
+            }
+            set.tag[line_index] = tag;
+            assign_bit(set.valid, line_index, true);
+            assign_bit(set.dirty, line_index, false);
+            assign_bit(set.shared, line_index, false);
+            set.access_time[line_index] = inst_count;
+            policy.fill(set, local_set_index, line_index, inst_count);
+        }
+
+        if (line_index != -1)
+        {
+            memcpy(set.data + line_index * block_words + word, data, words * sizeof(long long int));
+            if (dirty)
+            {
+                assign_bit(set.dirty, line_index, true);
+            }
+        }
+        else if (dirty)
+        {
+            next_level_write(address, words, data, true, false, inst_count);
+        }
+
+        policy.accessed(local_set_index, inst_count);
+    }
+
+    /*
+        Back-invalidation from an inclusive level below that evicts the blocks [address, address + words): drop the
+        lines holding them here and in the levels above. Dirty data is merged into data, newest (highest level) last;
+        the result is true if any of it was dirty.
+    */
+    bool invalidate_range(uint64_t address, int words, long long int *data)
+    {
+        bool dirty = false;
+        for (int offset = 0; offset < words; offset += block_words)
+        {
+            uint64_t line_address = (address + offset) >> block_shift;
+            int set_index = line_address & set_mask;
+            int local_set_index = set_index - first_set;
+            CacheSet set = lines.set(local_set_index);
+
+            int line_index = find_line(set, ways(), line_address >> set_bits);
+            if (line_index == -1)
+            {
+                continue;
+            }
+            if (test_bit(set.dirty, line_index))
+            {
+                memcpy(data + offset, set.data + line_index * block_words, block_words * sizeof(long long int));
+                dirty = true;
+            }
+            invalidate_line(set, local_set_index, line_index);
+            stats.invalidations++;
+        }
+        if (victims)
+        {
+            for (int offset = 0; offset < words; offset += block_words)
+            {
+                dirty |= victims->drop(address + offset, data + offset);
+            }
+        }
+
+        if (previous_level != NULL)
+        {
+            dirty |= previous_level->invalidate_range(address, words, data);
+        }
+        return dirty;
+    }
+
+    // read miss of another core (BusRd); keep_owned selects MOESI, where a dirty line stays here and is supplied
+    int snoop_read(uint64_t address, bool keep_owned, long long int &data, long long int inst_count)
+    {
+        policy.advance(inst_count - 1);
+
+        uint64_t line_address = address >> block_shift;
+        int set_index = line_address & set_mask;
+        CacheSet set = lines.set(set_index - first_set);
+        int line_index = find_line(set, ways(), line_address >> set_bits);
+        if (line_index == -1)
+        {
+            return SNOOP_MISS;
+        }
+
+        assign_bit(set.shared, line_index, true);
+        if (!test_bit(set.dirty, line_index))
+        {
+            return SNOOP_HIT;
+        }
+        if (keep_owned)
+        {
+            data = set.data[line_index * block_words + (address & (block_words - 1))];
+            return SNOOP_SUPPLIED;
+        }
+
+        // modified -> shared: the data goes to the next level
+        stats.writebacks++;
+        next_level_write(line_address << block_shift, block_words, set.data + line_index * block_words, true, false, inst_count);
+        assign_bit(set.dirty, line_index, false);
+        return SNOOP_FLUSHED;
+    }
+
+    // write of another core (BusRdX, BusUpgr): drop the line, flushing it if it is dirty
+    int snoop_invalidate(uint64_t address, long long int inst_count)
+    {
+        policy.advance(inst_count - 1);
+
+        uint64_t line_address = address >> block_shift;
+        int set_index = line_address & set_mask;
+        int local_set_index = set_index - first_set;
+        CacheSet set = lines.set(local_set_index);
+        int line_index = find_line(set, ways(), line_address >> set_bits);
+        if (line_index == -1)
+        {
+            return SNOOP_MISS;
+        }
+
+        int snoop = SNOOP_HIT;
+        if (test_bit(set.dirty, line_index))
+        {
+            stats.writebacks++;
+            next_level_write(line_address << block_shift, block_words, set.data + line_index * block_words, true, false, inst_count);
+            snoop = SNOOP_FLUSHED;
+        }
+        invalidate_line(set, local_set_index, line_index);
+        return snoop;
+    }
+
+    // apply the time driven policy updates (demotions) due at or before access inst_count
+    void advance(long long int inst_count)
+    {
+        policy.advance(inst_count);
+    }
+
+    // set by global index, which must be held by this cache
+    CacheSet set(int set_index)
+    {
+        return lines.set(set_index - first_set);
+    }
+
+    int sets_begin() const
+    {
+        return first_set;
+    }
+
+    int sets_end() const
+    {
+        return first_set + lines.sets();
+    }
+
+    int ways() const
+    {
+        return Ways > 0 ? Ways : associativity;
+    }
+
+    // data words (blocks of the first level) per line
+    int words() const
+    {
+        return block_words;
+    }
+
+    /*
+        Write the statistics, lines, replacement state and main memory of this level to a snapshot. Levels below,
+        coherence and the profile are not included, so snapshots are taken of a single cache (see cache_sim()).
+    */
+    void save(SnapshotWriter &out) const
+    {
+        out.write_value(stats);
+        lines.save(out);
+        policy.save(out);
+        main_memory->save(out);
+#if DEBUG
+        test_memory.save(out);
+#endif
+    }
+
+    // restore the state written by save() into a cache of the same geometry and policy
+    void load(SnapshotReader &in)
+    {
+        in.read_value(stats);
+        lines.load(in);
+        policy.load(in);
+        main_memory->load(in);
+#if DEBUG
+        test_memory.load(in);
+#endif
+    }
+
+    CacheStats stats;
+    long long int prefetch_uses;   // first demand accesses to prefetched lines (see enable_prefetch())
+    long long int prefetch_unused; // prefetched lines evicted or invalidated before any demand access
+
+private:
+    // load the line of tag starting at block address into way fill_index, from supplied (a single word sent by
+    // another core) if it is set, or from the line taken out of the victim cache if returned is set (take_victim())
+    void fill(CacheSet &set, int local_set_index, int fill_index, uint64_t tag, uint64_t address, int type, long long int inst_count,
+              const long long int *supplied = NULL, bool shared = false, bool returned = false)
+    {
+        bool dirty = false;
+        if (supplied != NULL)
+        {
+            set.data[fill_index * block_words] = *supplied;
+        }
+        else if (returned)
+        {
+            memcpy(set.data + fill_index * block_words, returned_line.data(), block_words * sizeof(long long int));
+            dirty = returned_dirty;
+        }
+        else
+        {
+            dirty = next_level_read(address, block_words, set.data + fill_index * block_words, type, inst_count);
+        }
+        set.tag[fill_index] = tag;
+        assign_bit(set.valid, fill_index, true);
+        assign_bit(set.dirty, fill_index, dirty);
+        assign_bit(set.shared, fill_index, shared);
+        set.access_time[fill_index] = inst_count;
+        policy.fill(set, local_set_index, fill_index, inst_count);
+    }
+
+    /*
+        Write out the line at way before it is replaced: an inclusive level first invalidates the copies above it,
+        then dirty data goes to the next level (an exclusive next level takes clean lines too). With a victim cache,
+        the line goes there and the line it displaces is written out instead. The line is left invalid, so a
+        back-invalidation caused by the write cannot find it again.
+    */
+    void evict(CacheSet &set, int set_index, int way, long long int inst_count)
+    {
+        uint64_t address = ((set.tag[way] << set_bits) | set_index) << block_shift;
+        long long int *line = set.data + way * block_words;
+        bool dirty = test_bit(set.dirty, way);
+        if (inclusion == INCLUSION_INCLUSIVE && previous_level != NULL)
+        {
+            dirty |= previous_level->invalidate_range(address, block_words, line);
+        }
+        assign_bit(set.valid, way, false);
+        untag(address);
+#if CACHE_PROFILE
+        if (profiler)
+        {
+            profiler->evicted(set_index - first_set);
+        }
+#endif
+
+        const long long int *data = line;
+        if (victims)
+        {
+            data = victims->insert(address, line, dirty, address, dirty);
+            if (data == NULL)
+            {
+                return;
+            }
+        }
+
+        bool exclusive_next = next_level != NULL && next_level->inclusion == INCLUSION_EXCLUSIVE;
+        if (dirty)
+        {
+            // when replacing dirty block, write back to main memory
+            stats.writebacks++;
+        }
+        if (dirty || exclusive_next)
+        {
+            next_level_write(address, block_words, data, dirty, exclusive_next, inst_count);
+        }
+    }
+
+    // invalidate a line handed up or back-invalidated
+    void invalidate_line(CacheSet &set, int local_set_index, int way)
+    {
+        untag(((set.tag[way] << set_bits) | (local_set_index + first_set)) << block_shift);
+        assign_bit(set.valid, way, false);
+        assign_bit(set.dirty, way, false);
+        assign_bit(set.shared, way, false);
+        policy.invalidate(set, local_set_index, way);
+    }
+
+    // take the line of block address out of the victim cache, if it is there, to be filled back
+    bool take_victim(uint64_t address)
+    {
+        return victims && victims->take(address, returned_line.data(), returned_dirty);
+    }
+
+    // a line at block address leaves the cache: a prefetched line not used so far never was
+    void untag(uint64_t address)
+    {
+        if (prefetching && prefetched.erase(address))
+        {
+            prefetch_unused++;
+        }
+    }
+
+    /*
+        The repeat - 1 accesses that follow the first one of a coalesced record, numbered from first. They all hit the
+        line the first one left in the cache, and only the first of them can change its place in the policy: the line
+        is then the most recently used one and, with T >= 1, is not demoted before the run ends, so the demotions of
+        the other lines of the set are due at the same times and leave them in the same ways as one access at a time.
+        With T < 1 the line can be demoted between two of the accesses, and without write allocation the writes of a
+        run can all miss; the accesses are then simulated one by one.
+    */
+    void repeat_hits(const Access &inst, long long int first)
+    {
+        long long int hits = inst.repeat - 1;
+        long long int last = first + hits - 1;
+        uint64_t memory_address = inst.address;
+        int set_index = (memory_address >> block_shift) & set_mask;
+        uint64_t tag = memory_address >> block_shift >> set_bits;
+        int word = memory_address & (block_words - 1);
+        int local_set_index = set_index - first_set;
+        CacheSet set = lines.set(local_set_index);
+
+        int hit_index = find_line(set, ways(), tag);
+        if (T < 1 || hit_index == -1)
+        {
+            Access single = inst;
+            single.repeat = 1;
+            for (long long int k = 0; k < hits; k++)
+            {
+                access(single, first + k);
+            }
+            return;
+        }
+
+        hit_index = policy.hit(set, local_set_index, hit_index, first);
+        set.access_time[hit_index] = last;
+
+        stats.accesses += hits;
+        if (inst.type == R)
+        {
+            stats.reads += hits;
+            stats.read_hits += hits;
+        }
+        else
+        {
+#if DEBUG
+            test_memory.write(memory_address, inst.data);
+#endif
+            stats.writes += hits;
+            stats.write_hits += hits;
+            set.data[hit_index * block_words + word] = inst.data;
+            if (write_policy == WRITE_THROUGH)
+            {
+                // only the last of the writes is left in the next level
+                next_level_write(memory_address, 1, &inst.data, true, false, last);
+            }
+            else
+            {
+                assign_bit(set.dirty, hit_index, true);
+            }
+        }
+#if CACHE_PROFILE
+        if (profiler)
+        {
+            profiler->repeated(local_set_index, hits);
+        }
+#endif
+
+        policy.accessed(local_set_index, first);
+        policy.advance(last);
+    }
+
+    // read words blocks from the next level (main memory for the last level); true if the data is dirty
+    bool next_level_read(uint64_t address, int words, long long int *data, int type, long long int inst_count)
+    {
+        if (next_level != NULL)
+        {
+            return next_level->fetch(address, words, data, type, inst_count);
+        }
+        for (int w = 0; w < words; w++)
+        {
+            data[w] = main_memory->read(address + w);
+        }
+        return false;
+    }
+
+    // write words blocks to the next level (main memory for the last level, which only takes dirty data)
+    void next_level_write(uint64_t address, int words, const long long int *data, bool dirty, bool allocate, long long int inst_count)
+    {
+        if (next_level != NULL)
+        {
+            next_level->write_back(address, words, data, dirty, allocate, inst_count);
+            return;
+        }
+        if (dirty)
+        {
+            for (int w = 0; w < words; w++)
+            {
+                main_memory->write(address + w, data[w]);
+            }
+        }
+    }
+
+    int total_sets;
+    int set_mask; // total_sets - 1
+    int set_bits; // log2(total_sets)
+    int associativity;
+    int first_set;
+    int block_words;
+    int block_shift;
+    int inclusion;
+    Cache *next_level;     // NULL: main memory
+    Cache *previous_level; // NULL: first level
+    CoherenceBus<Policy> *bus; // NULL: single core
+    int core;
+    CacheSets lines;
+    BackingMemory own_memory;
+    BackingMemory *main_memory; // block addressable (block size same as the first level), initialized with block addresses
+#if DEBUG
+    BackingMemory test_memory; // dummy test memory
+#endif
+    Policy policy;
+    int T;
+    int write_policy;
+    bool write_allocate;
+    std::unique_ptr<CacheProfile> profiler; // NULL: not profiled
+    std::unique_ptr<VictimCache> victims;   // NULL: no victim cache
+    std::vector<long long int> returned_line; // line taken out of the victim cache by take_victim()
+    bool returned_dirty;
+    bool prefetching;
+    std::unordered_set<uint64_t> prefetched; // block addresses of the prefetched lines not accessed yet
+};
+
+#endif
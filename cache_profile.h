@@ -0,0 +1,126 @@
+#ifndef CACHE_PROFILE_H
+#define CACHE_PROFILE_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <stdint.h>
+
+// build with -DCACHE_PROFILE=0 to compile the profiling hooks out of the access path
+#ifndef CACHE_PROFILE
+#define CACHE_PROFILE 1
+#endif
+
+// 3C classes of a miss
+#define MISS_COMPULSORY 0
+#define MISS_CAPACITY 1
+#define MISS_CONFLICT 2
+
+#define PROFILE_TOP_CONFLICTS 10 // lines listed by --profile
+
+/*
+    Miss classification and per-set counters of one cache, collected when enabled with Cache::enable_profile().
+
+    Misses are classified by the 3C model: compulsory if the line was never accessed before (seen set), capacity if a
+    fully associative LRU cache with as many lines as the profiled one (the shadow) misses too, conflict otherwise.
+    Conflict misses are also counted per line, to find the addresses that fight over a set.
+*/
+class CacheProfile
+{
+public:
+    CacheProfile(int sets, int ways)
+        : set_accesses(sets), set_misses(sets), set_evictions(sets), set_demotions(sets), misses(), capacity((size_t)sets * ways)
+    {
+    }
+
+    // access of line_address (an address in lines of the profiled cache) to local set s; miss is the result of the cache
+    void access(int s, uint64_t line_address, bool miss)
+    {
+        set_accesses[s]++;
+        bool shadow_hit = shadow_access(line_address);
+        bool seen = shadow_hit || !seen_lines.insert(line_address).second;
+        if (!miss)
+        {
+            return;
+        }
+
+        set_misses[s]++;
+        if (!seen)
+        {
+            misses[MISS_COMPULSORY]++;
+        }
+        else if (!shadow_hit)
+        {
+            misses[MISS_CAPACITY]++;
+        }
+        else
+        {
+            misses[MISS_CONFLICT]++;
+            conflicts[line_address]++;
+        }
+    }
+
+    // hits accesses to local set s of the line accessed last, which are hits of the shadow too
+    void repeated(int s, long long int hits)
+    {
+        set_accesses[s] += hits;
+    }
+
+    void evicted(int s)
+    {
+        set_evictions[s]++;
+    }
+
+    // the k lines with the most conflict misses as (line address, conflict misses), most first
+    std::vector<std::pair<uint64_t, long long int>> top_conflicts(size_t k) const
+    {
+        std::vector<std::pair<uint64_t, long long int>> lines(conflicts.begin(), conflicts.end());
+        auto more_conflicts = [](const std::pair<uint64_t, long long int> &a, const std::pair<uint64_t, long long int> &b)
+        {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        };
+        k = std::min(k, lines.size());
+        std::partial_sort(lines.begin(), lines.begin() + k, lines.end(), more_conflicts);
+        lines.resize(k);
+        return lines;
+    }
+
+    // per local set
+    std::vector<long long int> set_accesses;
+    std::vector<long long int> set_misses;
+    std::vector<long long int> set_evictions;
+    std::vector<long long int> set_demotions; // lines moved to the LOW PRIORITY group (priority-lru only)
+
+    long long int misses[3]; // by MISS_ class
+
+private:
+    // access line_address in the shadow; true on a hit
+    bool shadow_access(uint64_t line_address)
+    {
+        auto found = shadow_position.find(line_address);
+        if (found != shadow_position.end())
+        {
+            shadow.splice(shadow.begin(), shadow, found->second);
+            return true;
+        }
+
+        if (shadow.size() == capacity)
+        {
+            shadow_position.erase(shadow.back());
+            shadow.pop_back();
+        }
+        shadow.push_front(line_address);
+        shadow_position[line_address] = shadow.begin();
+        return false;
+    }
+
+    size_t capacity;
+    std::list<uint64_t> shadow; // most recent first
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> shadow_position;
+    std::unordered_set<uint64_t> seen_lines; // every line accessed so far
+    std::unordered_map<uint64_t, long long int> conflicts;
+};
+
+#endif
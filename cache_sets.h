@@ -0,0 +1,255 @@
+#ifndef CACHE_SETS_H
+#define CACHE_SETS_H
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#define CACHE_LINE_BYTES 64
+
+static inline bool test_bit(const uint64_t *bits, int i)
+{
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void assign_bit(uint64_t *bits, int i, bool value)
+{
+    uint64_t mask = (uint64_t)1 << (i & 63);
+    bits[i >> 6] = value ? (bits[i >> 6] | mask) : (bits[i >> 6] & ~mask);
+}
+
+// view of one set inside CacheSets
+struct CacheSet
+{
+    int &divider;               // = total lines in HIGH PRIORITY group = index of first line in LOW PRIORITY group
+    uint64_t *valid;            // one bit per line
+    uint64_t *dirty;            // one bit per line
+    uint64_t *shared;           // one bit per line, set if other caches may hold the line (multi-core coherence)
+    uint64_t *tag;              // tags of all lines packed together for lookup
+    long long int *access_time; // latest access time of each line
+    long long int *data;        // block data, words per line (line i at data + i * words)
+    int words;                  // data words per line
+};
+
+// exchange two lines of a set (used to move lines between the priority groups)
+static inline void swap_lines(CacheSet &set, int i, int j)
+{
+    if (i == j)
+    {
+        return;
+    }
+
+    bool valid = test_bit(set.valid, i);
+    assign_bit(set.valid, i, test_bit(set.valid, j));
+    assign_bit(set.valid, j, valid);
+
+    bool dirty = test_bit(set.dirty, i);
+    assign_bit(set.dirty, i, test_bit(set.dirty, j));
+    assign_bit(set.dirty, j, dirty);
+
+    bool shared = test_bit(set.shared, i);
+    assign_bit(set.shared, i, test_bit(set.shared, j));
+    assign_bit(set.shared, j, shared);
+
+    uint64_t tag = set.tag[i];
+    set.tag[i] = set.tag[j];
+    set.tag[j] = tag;
+
+    long long int access_time = set.access_time[i];
+    set.access_time[i] = set.access_time[j];
+    set.access_time[j] = access_time;
+
+    for (int w = 0; w < set.words; w++)
+    {
+        long long int data = set.data[i * set.words + w];
+        set.data[i * set.words + w] = set.data[j * set.words + w];
+        set.data[j * set.words + w] = data;
+    }
+}
+
+/*
+    Set search. Lookups compare the packed tags of up to 64 lines at once into a bit mask that is combined with the
+    valid bits, so hits and the first invalid line are found with a count-trailing-zeros instead of a branch per line.
+    Built with AVX2 (e.g. -march=native) the compare covers 4 lines per instruction, with SSE4.2 2 lines, otherwise
+    it falls back to tag_match_mask_scalar().
+*/
+
+// bit i set if tags[i] == tag, for n <= 64 lines
+static inline uint64_t tag_match_mask_scalar(const uint64_t *tags, int n, uint64_t tag)
+{
+    uint64_t mask = 0;
+    for (int i = 0; i < n; i++)
+    {
+        mask |= (uint64_t)(tags[i] == tag) << i;
+    }
+    return mask;
+}
+
+static inline uint64_t tag_match_mask(const uint64_t *tags, int n, uint64_t tag)
+{
+    uint64_t mask = 0;
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i key = _mm256_set1_epi64x((long long int)tag);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(tags + i)), key);
+        mask |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(equal)) << i;
+    }
+#elif defined(__SSE4_2__)
+    __m128i key = _mm_set1_epi64x((long long int)tag);
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i equal = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i *)(tags + i)), key);
+        mask |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(equal)) << i;
+    }
+#endif
+    return mask | (tag_match_mask_scalar(tags + i, n - i, tag) << i);
+}
+
+// index of the valid line holding tag, -1 if none
+static inline int find_line(const CacheSet &set, int ways, uint64_t tag)
+{
+    for (int base = 0; base < ways; base += 64)
+    {
+        int n = ways - base < 64 ? ways - base : 64;
+        uint64_t hits = tag_match_mask(set.tag + base, n, tag) & set.valid[base >> 6];
+        if (hits != 0)
+        {
+            return base + __builtin_ctzll(hits);
+        }
+    }
+    return -1;
+}
+
+// index of the first invalid line, -1 if none
+static inline int find_invalid_line(const CacheSet &set, int ways)
+{
+    for (int base = 0; base < ways; base += 64)
+    {
+        int n = ways - base < 64 ? ways - base : 64;
+        uint64_t invalid = ~set.valid[base >> 6] & (n == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1);
+        if (invalid != 0)
+        {
+            return base + __builtin_ctzll(invalid);
+        }
+    }
+    return -1;
+}
+
+// index of the line with the smallest access time in [begin, end), the first one on ties. This stays a scalar scan:
+// the running minimum rarely changes, so the branch is well predicted, and an AVX2 min-scan over the packed times
+// measured slower for 4 to 64 lines (see benchmark/lookup_benchmark.cpp).
+static inline int least_recent_line(const long long int *access_time, int begin, int end)
+{
+    int LRU_index = begin;
+    long long int least_recent_time = access_time[begin];
+    for (int i = begin + 1; i < end; i++)
+    {
+        if (access_time[i] < least_recent_time)
+        {
+            least_recent_time = access_time[i];
+            LRU_index = i;
+        }
+    }
+    return LRU_index;
+}
+
+/*
+    All lines of a cache in one zeroed, cache-line aligned heap allocation. Each set is a contiguous record
+
+        divider | valid bits | dirty bits | shared bits | tags | access times | data
+
+    padded to a multiple of CACHE_LINE_BYTES, so a set of up to 4 lines fits in two cache lines and all the state
+    touched by a lookup, promotion or demotion is in one place. A line holds block_words data words (one per block of
+    the first level, see Cache).
+*/
+class CacheSets
+{
+public:
+    CacheSets(int total_sets, int associativity, int block_words = 1) : total_sets(total_sets), associativity(associativity), block_words(block_words)
+    {
+        int mask_words = (associativity + 63) / 64;
+        valid_offset = 8;
+        dirty_offset = valid_offset + 8 * mask_words;
+        shared_offset = dirty_offset + 8 * mask_words;
+        tag_offset = shared_offset + 8 * mask_words;
+        access_time_offset = tag_offset + sizeof(uint64_t) * associativity;
+        data_offset = access_time_offset + sizeof(long long int) * associativity;
+        stride = (data_offset + sizeof(long long int) * associativity * block_words + CACHE_LINE_BYTES - 1) & ~(size_t)(CACHE_LINE_BYTES - 1);
+
+        storage = (char *)aligned_alloc(CACHE_LINE_BYTES, stride * total_sets);
+        if (storage == NULL)
+        {
+            std::cout << "Could not allocate the cache" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        memset(storage, 0, stride * total_sets);
+    }
+
+    ~CacheSets()
+    {
+        free(storage);
+    }
+
+    CacheSets(const CacheSets &) = delete;
+    CacheSets &operator=(const CacheSets &) = delete;
+
+    CacheSet set(int s)
+    {
+        char *base = storage + stride * s;
+        return CacheSet{*(int *)base, (uint64_t *)(base + valid_offset), (uint64_t *)(base + dirty_offset), (uint64_t *)(base + shared_offset),
+                        (uint64_t *)(base + tag_offset), (long long int *)(base + access_time_offset), (long long int *)(base + data_offset), block_words};
+    }
+
+    int sets() const
+    {
+        return total_sets;
+    }
+
+    int ways() const
+    {
+        return associativity;
+    }
+
+    int words() const
+    {
+        return block_words;
+    }
+
+    size_t set_bytes() const
+    {
+        return stride;
+    }
+
+    // all sets as they are laid out in memory
+    void save(SnapshotWriter &out) const
+    {
+        out.write(storage, stride * total_sets);
+    }
+
+    void load(SnapshotReader &in)
+    {
+        in.read(storage, stride * total_sets);
+    }
+
+private:
+    int total_sets;
+    int associativity;
+    int block_words;
+    size_t valid_offset;
+    size_t dirty_offset;
+    size_t shared_offset;
+    size_t tag_offset;
+    size_t access_time_offset;
+    size_t data_offset;
+    size_t stride;
+    char *storage;
+};
+
+#endif
@@ -1,639 +1,1881 @@
 #include <iostream>
 #include <vector>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <algorithm>
-#include <math.h>
+#include <thread>
+#include <atomic>
+#include <string.h>
+#include <limits.h>
+#include "trace_reader.h"
+#include "binary_trace.h"
+#include "cache.h"
+#include "cache_simulator.h"
+#include "interval_stats.h"
+#include "set_sampling.h"
+#include "stack_distance.h"
+#include "timing_model.h"
+#include "prefetcher.h"
 
 using namespace std;
 
-#define MAIN_MEMORY_BLOCKS 2048
-#define R 1
-#define W 0
-#define PRESENT 1
-#define NOT_PRESENT 0
-#define HIT 1
-#define MISS 0
-#define DEBUG 0
-
-// check validity of number (should be exponent of 2)
-bool check_validity(int n)
+#define PARALLEL_CHUNK_ACCESSES (1 << 20) // accesses handed to the workers at a time in parallel mode
+#define CACHE_SIM_BATCH_ACCESSES 4096       // accesses per CacheSimulator::access_batch() call in sequential mode
+#define BYTE_ACCESS_SIZE 4                  // default --access-size
+#define COALESCE_MAX_REPEAT (1 << 30)       // longest run of identical accesses --coalesce merges into one record
+#define MRC_DEFAULT_SCALE 16                // default --mrc-max-size, in cache sizes of the input file
+#define MRC_MAX_LINE_BITS 20                // largest cache of the miss ratio curve, in log2 of lines
+#define MRC_COMPARED_SIZES 4                // sizes of the curve also simulated with the compared policy
+#define TIMING_MEMORY_LATENCY 200           // default memory latency of --timing, in cycles
+
+// default hit latencies of L1, L2 and L3 with --timing, in cycles
+static const int default_latencies[] = {4, 12, 40};
+
+// what the simulations print at the end of the trace
+#define PRINT_STATS 1                       // statistics, and the profile if enabled
+#define PRINT_LINES 2                       // lines of every cache, left out with --no-dump
+
+#if DEBUG
+void print_cache_state(const CacheSimulator &cache)
 {
-    if (n == 0)
-        return false;
+    std::cout << "******************** CACHE ***************************" << endl;
+    for (int s = 0; s < cache.sets(); s++)
+    {
+        std::cout << "############################" << endl;
+        std::cout << "Set: " << s << endl;
+        std::cout << "set_priority_divider: " << cache.priority_divider(s) << endl;
 
-    return ceil(log2(n)) == floor(log2(n));
+        for (int ca = 0; ca < cache.ways(); ca++)
+        {
+            CacheLine line;
+            cache.line(s, ca, line);
+            std::cout << "----------------------------" << endl;
+            std::cout << "ca: " << ca << endl;
+            std::cout << "cache_block_valid: " << line.valid << endl;
+            std::cout << "cache_block_tag: " << line.tag << endl;
+            std::cout << "cache_block_latest_access_time: " << line.access_time << endl;
+            std::cout << "cache_block_dirty: " << line.dirty << endl;
+            std::cout << "cache_block_data: " << line.data << endl;
+        }
+    }
+    std::cout << "*****************************************************" << endl;
 }
+#endif
 
-// simulate cache
-int cache_sim(int cache_size, int cache_block_size, int cache_associativity, int T, vector<vector<int>> &instructions)
+void print_cache_lines(const CacheSimulator &cache, ostream &out = cout)
 {
-    if (!(check_validity(cache_size) && check_validity(cache_block_size) && check_validity(cache_associativity)))
+    for (int s = 0; s < cache.sets(); s++)
     {
-        cout << "Invalid parameters" << endl;
-        exit(EXIT_FAILURE);
+        for (int ca = 0; ca < cache.ways(); ca++)
+        {
+            CacheLine line;
+            cache.line(s, ca, line);
+            out << line.data << ", " << line.tag << ", " << line.valid << ", " << line.dirty << "\n";
+        }
     }
+}
 
-    int total_cache_blocks = cache_size / cache_block_size;
-    int total_sets = total_cache_blocks / cache_associativity;
-
-    if (total_cache_blocks < 1 || total_sets < 1)
+// print the lines of the sets held by cache
+template <class Policy>
+void print_cache_lines(Cache<Policy> &cache)
+{
+    for (int s = cache.sets_begin(); s < cache.sets_end(); s++)
     {
-        cout << "Invalid parameters" << endl;
-        exit(EXIT_FAILURE);
+        CacheSet set = cache.set(s);
+        for (int ca = 0; ca < cache.ways(); ca++)
+        {
+            // lines of lower levels hold several blocks of the first level: their data words are separated by spaces
+            std::cout << set.data[ca * set.words];
+            for (int w = 1; w < set.words; w++)
+            {
+                std::cout << " " << set.data[ca * set.words + w];
+            }
+            std::cout << ", " << set.tag[ca] << ", " << test_bit(set.valid, ca) << ", " << test_bit(set.dirty, ca) << "\n";
+        }
     }
+}
 
-    long long int main_memory[MAIN_MEMORY_BLOCKS]; // block addressable (block size same as cache_block_size)
-    long long int test_memory[MAIN_MEMORY_BLOCKS]; // dummy test memory
+void print_stats(const CacheStats &stats, const char *name = "Cache", ostream &out = cout)
+{
+    out << name << " statistics: " << endl;
+    out << "Number of Accesses: " << stats.accesses << endl;
+    out << "Number of Reads: " << stats.reads << endl;
+    out << "Number of Read Hits: " << stats.read_hits << endl;
+    out << "Number of Read Misses: " << stats.reads - stats.read_hits << endl;
+    out << "Number of Writes: " << stats.writes << endl;
+    out << "Number of Write Hits: " << stats.write_hits << endl;
+    out << "Number of Write Misses: " << stats.writes - stats.write_hits << endl;
+    out << "Hit ratio: " << (float)(stats.read_hits + stats.write_hits) / stats.accesses << endl;
+}
+
+// print the 3C miss classification, the counters of every set (numbered from first_set) and the lines with the most
+// conflict misses
+void print_profile(const CacheProfile &profile, int first_set = 0, ostream &out = cout)
+{
+    out << "Number of Compulsory Misses: " << profile.misses[MISS_COMPULSORY] << endl;
+    out << "Number of Capacity Misses: " << profile.misses[MISS_CAPACITY] << endl;
+    out << "Number of Conflict Misses: " << profile.misses[MISS_CONFLICT] << endl;
+    out << "******************** SETS ***************************" << endl;
+    out << "#Set, Accesses, Misses, Evictions, Demotions" << endl;
+    for (size_t s = 0; s < profile.set_accesses.size(); s++)
+    {
+        out << first_set + s << ", " << profile.set_accesses[s] << ", " << profile.set_misses[s] << ", "
+                  << profile.set_evictions[s] << ", " << profile.set_demotions[s] << "\n";
+    }
+    out << "******************** CONFLICTS **********************" << endl;
+    out << "#Line address, Conflict misses" << endl;
+    for (auto &line : profile.top_conflicts(PROFILE_TOP_CONFLICTS))
+    {
+        out << line.first << ", " << line.second << endl;
+    }
+    out << "*****************************************************" << endl;
+}
 
-    // initializing memory
-    for (int i = 0; i < MAIN_MEMORY_BLOCKS; i++)
+// stop with the message of a CacheSimulator error (result < 0), naming file if it is set
+void check_result(long long int result, const char *file = NULL)
+{
+    if (result >= 0)
+    {
+        return;
+    }
+    cout << CacheSimulator::error_message(result);
+    if (file != NULL)
     {
-        main_memory[i] = i;
-        test_memory[i] = i;
+        cout << ": " << file;
     }
+    cout << endl;
+    exit(EXIT_FAILURE);
+}
+
+// reads one trace per core, taking one access of every core that has accesses left in turn, so the cores are always
+// interleaved the same way. The configuration comes from the header of the first trace.
+template <class TraceReader>
+class InterleavedTraceReader
+{
+public:
+    InterleavedTraceReader(const vector<TraceReader *> &readers) : readers(readers), finished(readers.size(), false), next_core(0) {}
 
-    long long int cache_block_data[total_sets][cache_associativity]; // block addressable cache
+    void read_header(int &cache_size, int &cache_block_size, int &cache_associativity, int &T)
+    {
+        readers[0]->read_header(cache_size, cache_block_size, cache_associativity, T);
+        for (size_t c = 1; c < readers.size(); c++)
+        {
+            int ignored[4];
+            readers[c]->read_header(ignored[0], ignored[1], ignored[2], ignored[3]);
+        }
+    }
 
-    // initializing cache
-    for (int s = 0; s < total_sets; s++)
+    bool next(Access &access)
     {
-        for (int ca = 0; ca < cache_associativity; ca++)
+        for (size_t tries = 0; tries < readers.size(); tries++)
         {
-            cache_block_data[s][ca] = 0;
+            int core = next_core;
+            next_core = (next_core + 1) % readers.size();
+            if (!finished[core] && readers[core]->next(access))
+            {
+                access.core = core;
+                return true;
+            }
+            finished[core] = true;
         }
+        return false;
     }
 
-    int cache_block_valid[total_sets][cache_associativity] = {NOT_PRESENT};
-    int cache_block_tag[total_sets][cache_associativity] = {0};
-    int cache_block_dirty[total_sets][cache_associativity] = {0};
-    int cache_block_latest_access_time[total_sets][cache_associativity] = {0};
-    int set_priority_divider[total_sets] = {0}; // = total lines in HIGH PRIORITY group = index of first line in LOW PRIORITY group
+private:
+    vector<TraceReader *> readers;
+    vector<bool> finished;
+    int next_core;
+};
+
+struct CheckpointConfig
+{
+    const char *save_file = NULL;    // --checkpoint: snapshot written every `every` accesses and at the end of the trace
+    long long int every = 0;         // --checkpoint-every, 0: only at the end
+    const char *resume_file = NULL;  // --resume: snapshot to continue from
+    long long int trace_offset = -1; // --trace-offset: trace accesses skipped on resume, -1: as many as the snapshot simulated
+};
+
+struct IntervalConfig
+{
+    long long int every = 0;   // --interval: accesses per sample of the time series, 0: no time series
+    const char *file = NULL;   // --interval-file, the standard output by default
+    int format = INTERVAL_CSV; // --interval-format
+};
+
+/*
+    Simulate cache through the library interface (CacheSimulator), a batch of accesses at a time; TraceReader is
+    TextTraceReader or BinaryTraceReader and policy a POLICY_ constant. print_result (PRINT_ flags) selects whether the
+    final cache and the statistics are printed, the statistics followed by the miss classification and set counters
+    if profile is set. With checkpoints, the simulation can continue from a snapshot and write snapshots of its state;
+    with intervals, the statistics of every interval of accesses are written as a time series (see IntervalWriter).
+*/
+template <class TraceReader>
+int cache_sim(int cache_size, int cache_block_size, int cache_associativity, int T, int policy, TraceReader &trace, CacheStats &stats, int print_result,
+              bool profile = false, const CheckpointConfig *checkpoints = NULL, const IntervalConfig *intervals = NULL)
+{
+    CacheSimulator cache(cache_size, cache_block_size, cache_associativity, T, policy_names[policy]); // block addressable cache, initially all lines are invalid and in the LOW PRIORITY group
+    check_result(cache.status());
+    if (profile)
+    {
+        cache.enable_profile();
+    }
 
 #if DEBUG
+    int total_cache_blocks = cache_size / cache_block_size;
+    int total_sets = total_cache_blocks / cache_associativity;
     std::cout << "cache_size: " << cache_size << endl;
     std::cout << "cache_block_size: " << cache_block_size << endl;
     std::cout << "cache_associativity: " << cache_associativity << endl;
     std::cout << "T: " << T << endl;
     std::cout << "total_cache_blocks: " << total_cache_blocks << endl;
     std::cout << "total_sets: " << total_sets << endl;
+    print_cache_state(cache);
+#endif
 
-    std::cout << "******************** CACHE ***************************" << endl;
-    for (int s = 0; s < total_sets; s++)
+    // records of the trace, split where a coalesced one (see CoalescingTraceReader) crosses the end of a batch: the
+    // next one has at most limit accesses and the rest of it is kept for the following call
+    Access rest;
+    rest.repeat = 0;
+    auto next_record = [&trace, &rest](Access &record, long long int limit)
     {
-        std::cout << "############################" << endl;
-        std::cout << "Set: " << s << endl;
-        std::cout << "set_priority_divider: " << set_priority_divider[s] << endl;
+        if (rest.repeat == 0 && !trace.next(rest))
+        {
+            return false;
+        }
+        record = rest;
+        record.repeat = (int)min<long long int>(rest.repeat, limit);
+        rest.repeat -= record.repeat;
+        return true;
+    };
+
+    if (checkpoints != NULL && checkpoints->resume_file != NULL)
+    {
+        check_result(cache.load(checkpoints->resume_file), checkpoints->resume_file);
 
-        for (int ca = 0; ca < cache_associativity; ca++)
+        // continue the trace where the snapshot was taken, or at trace_offset
+        long long int skip = checkpoints->trace_offset >= 0 ? checkpoints->trace_offset : cache.stats().accesses;
+        Access skipped;
+        for (long long int i = 0; i < skip && next_record(skipped, skip - i); i += skipped.repeat)
         {
-            std::cout << "----------------------------" << endl;
-            std::cout << "ca: " << ca << endl;
-            std::cout << "cache_block_valid: " << cache_block_valid[s][ca] << endl;
-            std::cout << "cache_block_tag: " << cache_block_tag[s][ca] << endl;
-            std::cout << "cache_block_latest_access_time: " << cache_block_latest_access_time[s][ca] << endl;
-            std::cout << "cache_block_dirty: " << cache_block_dirty[s][ca] << endl;
-            std::cout << "cache_block_data: " << cache_block_data[s][ca] << endl;
         }
     }
-    std::cout << "*****************************************************" << endl;
-
-#endif
 
-    int inst_count = 0;
-    int total_reads = 0;
-    int total_read_hits = 0;
-    int total_writes = 0;
-    int total_write_hits = 0;
+    const char *save_file = checkpoints != NULL ? checkpoints->save_file : NULL;
+    long long int every = save_file != NULL ? checkpoints->every : 0;
 
-    for (auto it = instructions.begin(); it != instructions.end(); it++)
+    long long int interval = intervals != NULL ? intervals->every : 0;
+    unique_ptr<IntervalWriter> series;
+    if (interval > 0)
     {
-        vector<int> inst = *it;
-        if (inst.size() < 2)
+        series.reset(new IntervalWriter(intervals->file, intervals->format, cache.stats()));
+        if (!series->ok())
         {
-            std::cout << "Instruction error" << endl;
+            cout << "Cannot open " << intervals->file << endl;
             exit(EXIT_FAILURE);
         }
-        int memory_address = inst.at(0); // this is block address
-        int inst_type = inst.at(1);
-
-        /*
-            byte address:   <tag><set_index><offset>
-            block address:  <tag><set_index>
-        */
+    }
+    double total_lines = (double)cache.sets() * cache.ways();
 
-        int set_index = memory_address % total_sets;
-        int tag = memory_address / total_sets;
+    vector<Access> batch;
+    batch.reserve(CACHE_SIM_BATCH_ACCESSES);
+    Access inst;
+    while (true)
+    {
+        // DEBUG builds print the cache after every access; batches end at checkpoints and intervals
+        long long int inst_count = cache.stats().accesses;
+        long long int batch_size = DEBUG ? 1 : CACHE_SIM_BATCH_ACCESSES;
+        if (every > 0)
+        {
+            batch_size = min(batch_size, every - inst_count % every);
+        }
+        if (interval > 0)
+        {
+            batch_size = min(batch_size, interval - inst_count % interval);
+        }
+        batch.clear();
+        for (long long int accesses = 0; accesses < batch_size && next_record(inst, batch_size - accesses); accesses += inst.repeat)
+        {
+            batch.push_back(inst);
+        }
+        if (batch.empty())
+        {
+            break;
+        }
 
 #if DEBUG
         std::cout << "=========================== instruction ==============================" << endl;
         std::cout << "inst_count: " << inst_count << endl;
-        std::cout << "memory_address: " << memory_address << endl;
-        std::cout << "inst_type: " << (inst_type == R ? "R" : "W") << endl;
-        std::cout << "set_index: " << set_index << endl;
-        std::cout << "tag: " << tag << endl;
+        std::cout << "memory_address: " << inst.address << endl;
+        std::cout << "inst_type: " << (inst.type == R ? "R" : "W") << endl;
+        std::cout << "set_index: " << inst.address % total_sets << endl;
+        std::cout << "tag: " << inst.address / total_sets << endl;
 #endif
 
-        int hit_or_miss = MISS;
-
-        if (inst_type == R)
-        {
-            total_reads++;
-            long long int read_result = 0;
-            int first_non_valid_index = -1;
-            for (int i = 0; i < cache_associativity; i++)
-            {
-                if (cache_block_valid[set_index][i] == PRESENT)
-                {
-                    if (cache_block_tag[set_index][i] == tag)
-                    {
-                        // hit
-                        hit_or_miss = HIT;
-                        total_read_hits++;
-                        read_result = cache_block_data[set_index][i];
-
-                        if (i < set_priority_divider[set_index])
-                        {
-                            // hit in high priority group
-                            cache_block_latest_access_time[set_index][i] = inst_count; // update accessed block time
-                        }
-                        else
-                        {
-                            // hit in low priority group => move to high priority group
-                            int set_priority_divider_index = set_priority_divider[set_index];
-
-                            int temp_block_valid = cache_block_valid[set_index][set_priority_divider_index];
-                            int temp_block_tag = cache_block_tag[set_index][set_priority_divider_index];
-                            int temp_block_dirty = cache_block_dirty[set_index][set_priority_divider_index];
-                            int temp_block_access_time = cache_block_latest_access_time[set_index][set_priority_divider_index];
-                            long long int temp_block_data = cache_block_data[set_index][set_priority_divider_index];
-
-                            cache_block_valid[set_index][set_priority_divider_index] = cache_block_valid[set_index][i];
-                            cache_block_tag[set_index][set_priority_divider_index] = cache_block_tag[set_index][i];
-                            cache_block_dirty[set_index][set_priority_divider_index] = cache_block_dirty[set_index][i];
-                            cache_block_latest_access_time[set_index][set_priority_divider_index] = cache_block_latest_access_time[set_index][i];
-                            cache_block_data[set_index][set_priority_divider_index] = cache_block_data[set_index][i];
-
-                            cache_block_valid[set_index][i] = temp_block_valid;
-                            cache_block_tag[set_index][i] = temp_block_tag;
-                            cache_block_dirty[set_index][i] = temp_block_dirty;
-                            cache_block_latest_access_time[set_index][i] = temp_block_access_time;
-                            cache_block_data[set_index][i] = temp_block_data;
-
-                            cache_block_latest_access_time[set_index][set_priority_divider_index] = inst_count; // update accessed block time
-
-                            set_priority_divider[set_index] += 1;
-                        }
-                        break;
-                    }
-                }
-                else
-                {
-                    if (first_non_valid_index == -1)
-                    {
-                        first_non_valid_index = i;
-                    }
-                }
-            }
+        long long int hits = cache.access_batch(batch.data(), batch.size());
+        check_result(hits);
 
 #if DEBUG
-            std::cout << "first_non_valid_index: " << first_non_valid_index << endl;
+        std::cout << "hit/miss: " << (hits == 1 ? "HIT" : "MISS") << endl;
+        print_cache_state(cache);
 #endif
 
-            if (hit_or_miss == MISS)
-            {
-                if (first_non_valid_index != -1)
-                {
-                    // load from main memory to cache
-                    cache_block_data[set_index][first_non_valid_index] = main_memory[memory_address];
-                    cache_block_tag[set_index][first_non_valid_index] = tag;
-                    cache_block_dirty[set_index][first_non_valid_index] = 0;
-                    cache_block_valid[set_index][first_non_valid_index] = PRESENT;
-                    cache_block_latest_access_time[set_index][first_non_valid_index] = inst_count;
-                }
-                else
-                {
-                    // replacement: replace using LRU from low priority group, if low priority group is empty (i.e. all blocks are high priority) then use LRU in high priority group.
-
-                    if (set_priority_divider[set_index] < cache_associativity)
-                    {
-                        // LRU in low priority group
-                        int start_index = set_priority_divider[set_index];
-                        int least_recent_time = inst_count + 1;
-                        int LRU_index = 0;
-                        for (int i = start_index; i < cache_associativity; i++)
-                        {
-                            if (cache_block_latest_access_time[set_index][i] < least_recent_time)
-                            {
-                                least_recent_time = cache_block_latest_access_time[set_index][i];
-                                LRU_index = i;
-                            }
-                        }
-
-                        if (cache_block_dirty[set_index][LRU_index] == 1)
-                        {
-                            // when replacing dirty block, write back to main memory
-                            int corresponding_main_memory_address = (cache_block_tag[set_index][LRU_index] * total_sets) + set_index;
-                            main_memory[corresponding_main_memory_address] = cache_block_data[set_index][LRU_index];
-                        }
-
-                        // load from main memory to cache
-                        cache_block_data[set_index][LRU_index] = main_memory[memory_address];
-                        cache_block_tag[set_index][LRU_index] = tag;
-                        cache_block_dirty[set_index][LRU_index] = 0;
-                        cache_block_valid[set_index][LRU_index] = PRESENT;
-                        cache_block_latest_access_time[set_index][LRU_index] = inst_count;
-                    }
-                    else
-                    {
-                        // LRU in high priority group
-                        int start_index = 0;
-                        int least_recent_time = inst_count + 1;
-                        int LRU_index = 0;
-                        for (int i = start_index; i < cache_associativity; i++)
-                        {
-                            if (cache_block_latest_access_time[set_index][i] < least_recent_time)
-                            {
-                                least_recent_time = cache_block_latest_access_time[set_index][i];
-                                LRU_index = i;
-                            }
-                        }
-
-                        if (cache_block_dirty[set_index][LRU_index] == 1)
-                        {
-                            // when replacing dirty block, write back to main memory
-                            int corresponding_main_memory_address = (cache_block_tag[set_index][LRU_index] * total_sets) + set_index;
-                            main_memory[corresponding_main_memory_address] = cache_block_data[set_index][LRU_index];
-                        }
-
-                        set_priority_divider[set_index]--;
-                        int set_priority_divider_index = set_priority_divider[set_index];
-
-                        cache_block_data[set_index][LRU_index] = cache_block_data[set_index][set_priority_divider_index];
-                        cache_block_tag[set_index][LRU_index] = cache_block_tag[set_index][set_priority_divider_index];
-                        cache_block_dirty[set_index][LRU_index] = cache_block_dirty[set_index][set_priority_divider_index];
-                        cache_block_valid[set_index][LRU_index] = cache_block_valid[set_index][set_priority_divider_index];
-                        cache_block_latest_access_time[set_index][LRU_index] = cache_block_latest_access_time[set_index][set_priority_divider_index];
-
-                        // load from main memory to cache
-                        cache_block_data[set_index][set_priority_divider_index] = main_memory[memory_address];
-                        cache_block_tag[set_index][set_priority_divider_index] = tag;
-                        cache_block_dirty[set_index][set_priority_divider_index] = 0;
-                        cache_block_valid[set_index][set_priority_divider_index] = PRESENT;
-                        cache_block_latest_access_time[set_index][set_priority_divider_index] = inst_count;
-                    }
-                }
-
-                read_result = main_memory[memory_address];
-            }
-
-#if DEBUG
-            cout << "Read result: " << read_result << endl;
-            cout << "Read result from test_memory: " << test_memory[memory_address] << endl;
-            if (read_result == test_memory[memory_address])
-            {
-                cout << "Correct read!!" << endl;
-            }
-            else
-            {
-                cout << "Wrong read!!" << endl;
-            }
-#endif
+        if (every > 0 && cache.stats().accesses % every == 0)
+        {
+            check_result(cache.save(save_file), save_file);
         }
-        else if (inst_type == W)
+        if (interval > 0 && cache.stats().accesses % interval == 0)
         {
-            // write back with write allocate
-
-            if (inst.size() != 3)
-            {
-                std::cout << "Instruction error" << endl;
-                exit(EXIT_FAILURE);
-            }
-            long long int write_data = inst.at(2);
+            series->write(cache.stats(), cache.high_priority_lines() / total_lines);
+        }
+    }
 
-            test_memory[memory_address] = write_data;
-            total_writes++;
+    if (series)
+    {
+        // the last, shorter interval
+        series->write(cache.stats(), cache.high_priority_lines() / total_lines);
+        if (!series->close())
+        {
+            cout << "Cannot write " << (intervals->file != NULL ? intervals->file : "the interval statistics") << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
 
-            int first_non_valid_index = -1;
-            for (int i = 0; i < cache_associativity; i++)
-            {
-                if (cache_block_valid[set_index][i] == PRESENT)
-                {
-                    if (cache_block_tag[set_index][i] == tag)
-                    {
-                        // hit
-                        hit_or_miss = HIT;
-                        total_write_hits++;
+    if (save_file != NULL)
+    {
+        check_result(cache.save(save_file), save_file);
+    }
 
-                        if (i < set_priority_divider[set_index])
-                        {
-                            // hit in high priority group
-                            cache_block_data[set_index][i] = write_data;
-                            cache_block_dirty[set_index][i] = 1;
-                            cache_block_latest_access_time[set_index][i] = inst_count; // update accessed block time
-                        }
-                        else
-                        {
-                            // hit in low priority group => move to high priority group
-                            int set_priority_divider_index = set_priority_divider[set_index];
-
-                            int temp_block_valid = cache_block_valid[set_index][set_priority_divider_index];
-                            int temp_block_tag = cache_block_tag[set_index][set_priority_divider_index];
-                            int temp_block_dirty = cache_block_dirty[set_index][set_priority_divider_index];
-                            int temp_block_access_time = cache_block_latest_access_time[set_index][set_priority_divider_index];
-                            long long int temp_block_data = cache_block_data[set_index][set_priority_divider_index];
-
-                            cache_block_valid[set_index][set_priority_divider_index] = cache_block_valid[set_index][i];
-                            cache_block_tag[set_index][set_priority_divider_index] = cache_block_tag[set_index][i];
-                            cache_block_dirty[set_index][set_priority_divider_index] = cache_block_dirty[set_index][i];
-                            cache_block_latest_access_time[set_index][set_priority_divider_index] = cache_block_latest_access_time[set_index][i];
-                            cache_block_data[set_index][set_priority_divider_index] = cache_block_data[set_index][i];
-
-                            cache_block_valid[set_index][i] = temp_block_valid;
-                            cache_block_tag[set_index][i] = temp_block_tag;
-                            cache_block_dirty[set_index][i] = temp_block_dirty;
-                            cache_block_latest_access_time[set_index][i] = temp_block_access_time;
-                            cache_block_data[set_index][i] = temp_block_data;
-
-                            cache_block_data[set_index][set_priority_divider_index] = write_data;
-                            cache_block_dirty[set_index][set_priority_divider_index] = 1;
-                            cache_block_latest_access_time[set_index][set_priority_divider_index] = inst_count; // update accessed block time
-
-                            set_priority_divider[set_index] += 1;
-                        }
-                        break;
-                    }
-                }
-                else
-                {
-                    if (first_non_valid_index == -1)
-                    {
-                        first_non_valid_index = i;
-                    }
-                }
-            }
+    stats = cache.stats();
 
-#if DEBUG
-            std::cout << "first_non_valid_index: " << first_non_valid_index << endl;
-#endif
+    // a time series on the standard output stays a valid CSV or JSON document: the final output goes to stderr
+    ostream &out = series && intervals->file == NULL ? cerr : cout;
+    if (print_result & PRINT_LINES)
+    {
+        out << "******************** CACHE ***************************" << endl;
+        out << "#Data, Tag, Valid-status(valid=1), dirty-status(dirty=1)" << endl;
+        print_cache_lines(cache, out);
+        out << "*****************************************************" << endl;
+    }
+    if (print_result & PRINT_STATS)
+    {
+        print_stats(stats, "Cache", out);
+        if (profile)
+        {
+            print_profile(*cache.profile(), 0, out);
+        }
+    }
 
-            if (hit_or_miss == MISS)
-            {
-                // write to main memory
-                main_memory[memory_address] = write_data;
+    return 0;
+}
 
-                if (first_non_valid_index != -1)
-                {
-                    // load from main memory to cache
-                    cache_block_data[set_index][first_non_valid_index] = main_memory[memory_address];
-                    cache_block_tag[set_index][first_non_valid_index] = tag;
-                    cache_block_valid[set_index][first_non_valid_index] = PRESENT;
-                    cache_block_dirty[set_index][first_non_valid_index] = 0;
-                    cache_block_latest_access_time[set_index][first_non_valid_index] = inst_count;
-                }
-                else
-                {
-                    // replacement: replace using LRU from low priority group, if low priority group is empty (i.e. all blocks are high priority) then use LRU in high priority group.
+/*
+    Simulate one cache on several threads. Each worker owns a contiguous range of sets with its own lines, demotion
+    queue and main memory (a block address always maps to the same set, so the memories never overlap). The trace is
+    read in chunks; while the workers simulate the accesses of one chunk that fall into their sets, stamped with their
+    global sequence numbers, the next chunk is read. The result is identical to cache_sim().
+*/
+template <class Policy, class TraceReader>
+int parallel_cache_sim(int cache_size, int cache_block_size, int cache_associativity, int T, TraceReader &trace, int threads, CacheStats &stats, int print_result)
+{
+    if (!check_parameters(cache_size, cache_block_size, cache_associativity))
+    {
+        cout << "Invalid parameters" << endl;
+        exit(EXIT_FAILURE);
+    }
 
-                    if (set_priority_divider[set_index] < cache_associativity)
-                    {
-                        // LRU in low priority group
-                        int start_index = set_priority_divider[set_index];
-                        int least_recent_time = inst_count + 1;
-                        int LRU_index = 0;
-                        for (int i = start_index; i < cache_associativity; i++)
-                        {
-                            if (cache_block_latest_access_time[set_index][i] < least_recent_time)
-                            {
-                                least_recent_time = cache_block_latest_access_time[set_index][i];
-                                LRU_index = i;
-                            }
-                        }
+    int total_cache_blocks = cache_size / cache_block_size;
+    int total_sets = total_cache_blocks / cache_associativity;
 
-                        if (cache_block_dirty[set_index][LRU_index] == 1)
-                        {
-                            // when replacing dirty block, write back to main memory
-                            int corresponding_main_memory_address = (cache_block_tag[set_index][LRU_index] * total_sets) + set_index;
-                            main_memory[corresponding_main_memory_address] = cache_block_data[set_index][LRU_index];
-                        }
+    int partitions = min(threads, total_sets);
+    vector<Cache<Policy> *> caches;
+    for (int p = 0; p < partitions; p++)
+    {
+        int first_set = (long long int)total_sets * p / partitions;
+        int end_set = (long long int)total_sets * (p + 1) / partitions;
+        caches.push_back(new Cache<Policy>(total_sets, cache_associativity, T, first_set, end_set - first_set));
+    }
 
-                        // load from main memory to cache
-                        cache_block_data[set_index][LRU_index] = main_memory[memory_address];
-                        cache_block_tag[set_index][LRU_index] = tag;
-                        cache_block_valid[set_index][LRU_index] = PRESENT;
-                        cache_block_dirty[set_index][LRU_index] = 0;
-                        cache_block_latest_access_time[set_index][LRU_index] = inst_count;
-                    }
-                    else
-                    {
-                        // LRU in high priority group
-                        int start_index = 0;
-                        int least_recent_time = inst_count + 1;
-                        int LRU_index = 0;
-                        for (int i = start_index; i < cache_associativity; i++)
-                        {
-                            if (cache_block_latest_access_time[set_index][i] < least_recent_time)
-                            {
-                                least_recent_time = cache_block_latest_access_time[set_index][i];
-                                LRU_index = i;
-                            }
-                        }
+    // read the next chunk of records; the result is the number of accesses in it
+    auto read_chunk = [&trace](vector<Access> &chunk)
+    {
+        chunk.clear();
+        long long int accesses = 0;
+        Access access;
+        while (chunk.size() < PARALLEL_CHUNK_ACCESSES && trace.next(access))
+        {
+            chunk.push_back(access);
+            accesses += access.repeat;
+        }
+        return accesses;
+    };
 
-                        if (cache_block_dirty[set_index][LRU_index] == 1)
-                        {
-                            // when replacing dirty block, write back to main memory
-                            int corresponding_main_memory_address = (cache_block_tag[set_index][LRU_index] * total_sets) + set_index;
-                            main_memory[corresponding_main_memory_address] = cache_block_data[set_index][LRU_index];
-                        }
+    vector<Access> chunk, next_chunk;
+    chunk.reserve(PARALLEL_CHUNK_ACCESSES);
+    next_chunk.reserve(PARALLEL_CHUNK_ACCESSES);
+    long long int chunk_accesses = read_chunk(chunk);
 
-                        set_priority_divider[set_index]--;
-                        int set_priority_divider_index = set_priority_divider[set_index];
-
-                        cache_block_data[set_index][LRU_index] = cache_block_data[set_index][set_priority_divider_index];
-                        cache_block_tag[set_index][LRU_index] = cache_block_tag[set_index][set_priority_divider_index];
-                        cache_block_dirty[set_index][LRU_index] = cache_block_dirty[set_index][set_priority_divider_index];
-                        cache_block_valid[set_index][LRU_index] = cache_block_valid[set_index][set_priority_divider_index];
-                        cache_block_latest_access_time[set_index][LRU_index] = cache_block_latest_access_time[set_index][set_priority_divider_index];
-
-                        // load from main memory to cache
-                        cache_block_data[set_index][set_priority_divider_index] = main_memory[memory_address];
-                        cache_block_tag[set_index][set_priority_divider_index] = tag;
-                        cache_block_dirty[set_index][set_priority_divider_index] = 0;
-                        cache_block_valid[set_index][set_priority_divider_index] = PRESENT;
-                        cache_block_latest_access_time[set_index][set_priority_divider_index] = inst_count;
-                    }
-                }
-            }
-        }
-        else
+    long long int inst_count = 0; // sequence number of the first access in chunk
+    while (!chunk.empty())
+    {
+        vector<thread> workers;
+        for (int p = 0; p < partitions; p++)
         {
-            std::cout << "Incorrect inst type" << endl;
-            return -1;
+            workers.push_back(thread([&chunk, &caches, p, inst_count]()
+                                     {
+                                         Cache<Policy> &cache = *caches[p];
+                                         long long int sequence = inst_count;
+                                         for (size_t i = 0; i < chunk.size(); i++)
+                                         {
+                                             if (cache.holds(chunk[i].address))
+                                             {
+                                                 cache.access(chunk[i], sequence);
+                                             }
+                                             sequence += chunk[i].repeat;
+                                         }
+                                     }));
         }
-
-        // move lines to low priority group if not accessed for T cache accesses
-        for (int i = 0; i < total_sets; i++)
+        long long int next_chunk_accesses = read_chunk(next_chunk);
+        for (auto &worker : workers)
         {
-            for (int j = 0; j < cache_associativity; j++)
-            {
-                if (j < set_priority_divider[i] && inst_count - cache_block_latest_access_time[i][j] >= T)
-                {
-#if DEBUG
-                    std::cout << "moving line to low priority group..." << endl;
-                    std::cout << "set: " << i << endl;
-                    std::cout << "ca: " << j << endl;
-#endif
-                    int set_priority_divider_index = set_priority_divider[i];
-
-                    int temp_block_valid = cache_block_valid[i][set_priority_divider_index - 1];
-                    int temp_block_tag = cache_block_tag[i][set_priority_divider_index - 1];
-                    int temp_block_dirty = cache_block_dirty[i][set_priority_divider_index - 1];
-                    int temp_block_access_time = cache_block_latest_access_time[i][set_priority_divider_index - 1];
-                    long long int temp_block_data = cache_block_data[i][set_priority_divider_index - 1];
-
-                    cache_block_valid[i][set_priority_divider_index - 1] = cache_block_valid[i][j];
-                    cache_block_tag[i][set_priority_divider_index - 1] = cache_block_tag[i][j];
-                    cache_block_dirty[i][set_priority_divider_index - 1] = cache_block_dirty[i][j];
-                    cache_block_latest_access_time[i][set_priority_divider_index - 1] = cache_block_latest_access_time[i][j];
-                    cache_block_data[i][set_priority_divider_index - 1] = cache_block_data[i][j];
-
-                    cache_block_valid[i][j] = temp_block_valid;
-                    cache_block_tag[i][j] = temp_block_tag;
-                    cache_block_dirty[i][j] = temp_block_dirty;
-                    cache_block_latest_access_time[i][j] = temp_block_access_time;
-                    cache_block_data[i][j] = temp_block_data;
-
-                    set_priority_divider[i] -= 1;
-                }
-            }
+            worker.join();
         }
 
-        inst_count++;
+        inst_count += chunk_accesses;
+        chunk_accesses = next_chunk_accesses;
+        swap(chunk, next_chunk);
+    }
 
-#if DEBUG
-        std::cout << "hit/miss: " << (hit_or_miss == HIT ? "HIT" : "MISS") << endl;
+    // policy updates (demotions) after each partition's last access up to the end of the trace
+    stats = CacheStats();
+    for (Cache<Policy> *cache : caches)
+    {
+        cache->advance(inst_count - 1);
+        stats.accesses += cache->stats.accesses;
+        stats.reads += cache->stats.reads;
+        stats.read_hits += cache->stats.read_hits;
+        stats.writes += cache->stats.writes;
+        stats.write_hits += cache->stats.write_hits;
+        stats.writebacks += cache->stats.writebacks;
+        stats.invalidations += cache->stats.invalidations;
+    }
+
+    if (print_result & PRINT_LINES)
+    {
         std::cout << "******************** CACHE ***************************" << endl;
-        for (int s = 0; s < total_sets; s++)
+        std::cout << "#Data, Tag, Valid-status(valid=1), dirty-status(dirty=1)" << endl;
+        for (Cache<Policy> *cache : caches)
         {
-            std::cout << "############################" << endl;
-            std::cout << "Set: " << s << endl;
-            std::cout << "set_priority_divider: " << set_priority_divider[s] << endl;
-
-            for (int ca = 0; ca < cache_associativity; ca++)
-            {
-                std::cout << "----------------------------" << endl;
-                std::cout << "ca: " << ca << endl;
-                std::cout << "cache_block_valid: " << cache_block_valid[s][ca] << endl;
-                std::cout << "cache_block_tag: " << cache_block_tag[s][ca] << endl;
-                std::cout << "cache_block_latest_access_time: " << cache_block_latest_access_time[s][ca] << endl;
-                std::cout << "cache_block_dirty: " << cache_block_dirty[s][ca] << endl;
-                std::cout << "cache_block_data: " << cache_block_data[s][ca] << endl;
-            }
+            print_cache_lines(*cache);
         }
         std::cout << "*****************************************************" << endl;
-#endif
     }
-
-    std::cout << "******************** CACHE ***************************" << endl;
-    std::cout << "#Data, Tag, Valid-status(valid=1), dirty-status(dirty=1)" << endl;
-    for (int s = 0; s < total_sets; s++)
+    if (print_result & PRINT_STATS)
     {
-        for (int ca = 0; ca < cache_associativity; ca++)
-        {
-            std::cout << cache_block_data[s][ca] << ", " << cache_block_tag[s][ca] << ", " << cache_block_valid[s][ca] << ", " << cache_block_dirty[s][ca] << endl;
-        }
+        print_stats(stats);
     }
-    std::cout << "*****************************************************" << endl;
-    std::cout << "Cache statistics: " << endl;
-    std::cout << "Number of Accesses: " << inst_count << endl;
-    std::cout << "Number of Reads: " << total_reads << endl;
-    std::cout << "Number of Read Hits: " << total_read_hits << endl;
-    std::cout << "Number of Read Misses: " << total_reads - total_read_hits << endl;
-    std::cout << "Number of Writes: " << total_writes << endl;
-    std::cout << "Number of Write Hits: " << total_write_hits << endl;
-    std::cout << "Number of Write Misses: " << total_writes - total_write_hits << endl;
-    std::cout << "Hit ratio: " << (float)(total_read_hits + total_write_hits) / inst_count << endl;
 
+    for (Cache<Policy> *cache : caches)
+    {
+        delete cache;
+    }
     return 0;
 }
 
-int main(int argc, char **argv)
+// print a hit ratio estimate of a sampled simulation
+void print_estimate(const char *name, const RatioEstimate &estimate)
 {
-    if (argc < 2)
+    std::cout << name << ": " << estimate.ratio;
+    if (estimate.bounded)
     {
-        std::cout << "Enter all arguments" << endl;
-        exit(EXIT_SUCCESS);
+        std::cout << " (95% confidence interval: " << estimate.low << " - " << estimate.high << ")";
     }
+    std::cout << endl;
+}
 
-    ifstream infile(argv[1]);
+/*
+    Simulate only a sample of the sets of one cache (about one set in ratio, see SetSample) and estimate the hit
+    ratios of the whole cache from them. Accesses to the other sets are dropped as they are read; the sampled ones
+    keep their sequence numbers in the whole trace, so the sampled sets behave exactly as in cache_sim(). The exact
+    access counts are printed with the estimated hit ratios and misses if print_result has PRINT_STATS.
+*/
+template <class Policy, class TraceReader>
+int sampled_cache_sim(int cache_size, int cache_block_size, int cache_associativity, int T, TraceReader &trace, int ratio, int mode, int print_result)
+{
+    if (!check_parameters(cache_size, cache_block_size, cache_associativity))
+    {
+        cout << "Invalid parameters" << endl;
+        exit(EXIT_FAILURE);
+    }
 
-    int cache_size, cache_block_size, cache_associativity, T;
-    vector<vector<int>> instructions;
+    int total_sets = cache_size / cache_block_size / cache_associativity;
+    SetSample sample(total_sets, min(ratio, total_sets), mode);
+    Cache<Policy> cache(sample.sets(), cache_associativity, T);
 
-    string line;
-    int line_count = 0;
-    while (getline(infile, line))
+    CacheStats stats = CacheStats(); // of all accesses; only the counts of accesses, reads and writes
+    vector<long long int> set_reads(sample.sets()), set_read_hits(sample.sets()), set_writes(sample.sets()), set_write_hits(sample.sets());
+    long long int inst_count = 0;
+    Access inst;
+    while (trace.next(inst))
     {
-        if (line.size() > 0 && line[0] != '#')
-        {
-            line_count++;
-            istringstream iss(line);
+        stats.accesses += inst.repeat;
+        stats.reads += inst.type == R ? inst.repeat : 0;
+        stats.writes += inst.type == W ? inst.repeat : 0;
 
-            if (line_count == 1)
-            {
-                iss >> cache_size;
-            }
-            else if (line_count == 2)
-            {
-                iss >> cache_block_size;
-            }
-            else if (line_count == 3)
-            {
-                iss >> cache_associativity;
-            }
-            else if (line_count == 4)
+        int s = sample.set(inst.address);
+        if (s >= 0)
+        {
+            inst.address = sample.compact(inst.address);
+            // the accesses after the first of a coalesced record hit
+            long long int hits = (cache.access(inst, inst_count) == HIT) + inst.repeat - 1;
+            if (inst.type == R)
             {
-                iss >> T;
+                set_reads[s] += inst.repeat;
+                set_read_hits[s] += hits;
             }
             else
             {
-                string memory_address, read_or_write, write_data;
-                vector<int> inst;
-
-                if (getline(iss, memory_address, ','))
-                {
-                    inst.push_back(stoi(memory_address));
-                }
+                set_writes[s] += inst.repeat;
+                set_write_hits[s] += hits;
+            }
+        }
+        inst_count += inst.repeat;
+    }
+
+    if (print_result & PRINT_STATS)
+    {
+        vector<long long int> set_accesses(sample.sets()), set_hits(sample.sets());
+        for (int s = 0; s < sample.sets(); s++)
+        {
+            set_accesses[s] = set_reads[s] + set_writes[s];
+            set_hits[s] = set_read_hits[s] + set_write_hits[s];
+        }
+        RatioEstimate reads = estimate_ratio(set_reads, set_read_hits, total_sets);
+        RatioEstimate writes = estimate_ratio(set_writes, set_write_hits, total_sets);
+        RatioEstimate all = estimate_ratio(set_accesses, set_hits, total_sets);
+
+        std::cout << "Cache statistics (estimated from " << sample.sets() << " of " << total_sets << " sets): " << endl;
+        std::cout << "Number of Accesses: " << stats.accesses << endl;
+        std::cout << "Number of Sampled Accesses: " << cache.stats.accesses << endl;
+        std::cout << "Number of Reads: " << stats.reads << endl;
+        std::cout << "Estimated Number of Read Misses: " << llround(stats.reads * (1 - reads.ratio)) << endl;
+        std::cout << "Number of Writes: " << stats.writes << endl;
+        std::cout << "Estimated Number of Write Misses: " << llround(stats.writes * (1 - writes.ratio)) << endl;
+        print_estimate("Read hit ratio", reads);
+        print_estimate("Write hit ratio", writes);
+        print_estimate("Hit ratio", all);
+    }
+    return 0;
+}
+
+struct LevelConfig
+{
+    int cache_size;
+    int cache_block_size;
+    int cache_associativity;
+    int T;
+};
+
+// write policy and victim cache of the first level, and timing model of hierarchy_sim()
+struct TimingConfig
+{
+    bool enabled = false;           // --timing
+    vector<int> latencies;          // --latency: hit latency of every level, then the memory latency; empty: the defaults
+    int write_buffer = 0;           // --write-buffer: entries, 0: writes wait for the next level
+    int mshrs = 0;                  // --mshrs: entries, 0: blocking
+    int victim_cache = 0;           // --victim-cache: lines, 0: none
+    int write_policy = WRITE_BACK;  // --write-through
+    bool write_allocate = true;     // --no-write-allocate
+};
+
+// prefetcher of the first level in hierarchy_sim()
+struct PrefetchConfig
+{
+    int kind = PREFETCH_NONE;               // --prefetch
+    int degree = 0;                         // --prefetch-degree, 0: the default of the prefetcher
+    int buffers = PREFETCH_STREAM_BUFFERS;  // --stream-buffers
+};
+
+void print_timing(const TimingModel &timing, long long int accesses)
+{
+    std::cout << "Timing statistics: " << endl;
+    std::cout << "Number of Cycles: " << timing.cycles() << endl;
+    long long int total_latency = 0;
+    for (int type : {R, W})
+    {
+        for (const auto &entry : timing.latencies_of(type))
+        {
+            total_latency += entry.first * entry.second;
+        }
+    }
+    std::cout << "Average Memory Access Time: " << (double)total_latency / accesses << " cycles" << endl;
+    for (int type : {R, W})
+    {
+        const map<long long int, long long int> &latencies = timing.latencies_of(type);
+        long long int count = 0, cycles = 0;
+        for (const auto &entry : latencies)
+        {
+            count += entry.second;
+            cycles += entry.first * entry.second;
+        }
+        const char *name = type == R ? "Read" : "Write";
+        std::cout << name << " Average Memory Access Time: " << (count > 0 ? (double)cycles / count : 0) << " cycles" << endl;
+        std::cout << name << " Latency Percentiles (";
+        for (double percent : timing_percentiles)
+        {
+            std::cout << "p" << percent << ", ";
+        }
+        std::cout << "max): ";
+        for (double percent : timing_percentiles)
+        {
+            std::cout << latency_percentile(latencies, percent) << ", ";
+        }
+        std::cout << (latencies.empty() ? 0 : latencies.rbegin()->first) << endl;
+    }
+
+    const WriteBuffer *buffer = timing.write_buffer();
+    if (buffer != NULL)
+    {
+        std::cout << "Number of Write Buffer Writes: " << buffer->writes << endl;
+        std::cout << "Number of Coalesced Writes: " << buffer->coalesced << endl;
+        std::cout << "Number of Write Buffer Stalls: " << buffer->stalls << endl;
+        std::cout << "Number of Stall Cycles: " << buffer->stall_cycles << endl;
+    }
+
+    const MshrFile *mshrs = timing.mshr_file();
+    if (mshrs != NULL)
+    {
+        std::cout << "Number of MSHR Allocations: " << mshrs->allocations << endl;
+        std::cout << "Number of MSHR Merges: " << mshrs->merges << endl;
+        std::cout << "Number of MSHR Full Stalls: " << mshrs->stalls << endl;
+        std::cout << "Number of MSHR Stall Cycles: " << mshrs->stall_cycles << endl;
+        std::cout << "Average MSHR Occupancy: " << (timing.cycles() > 0 ? (double)mshrs->busy_cycles / timing.cycles() : 0) << endl;
+        std::cout << "Peak MSHR Occupancy: " << mshrs->peak << endl;
+    }
+}
+
+void print_prefetch(const PrefetchConfig &config, const PrefetchTracker &tracker, const Prefetcher &prefetcher, const CacheStats &stats,
+                    long long int unused)
+{
+    long long int prefetches = tracker.issued + prefetcher.fetched;
+    long long int misses = stats.accesses - stats.read_hits - stats.write_hits;
+    std::cout << "Prefetch statistics (" << prefetcher_names[config.kind] << ", degree " << config.degree << "): " << endl;
+    std::cout << "Number of Prefetches: " << prefetches << endl;
+    std::cout << "Number of Redundant Prefetches: " << tracker.redundant << endl;
+    std::cout << "Number of Useful Prefetches: " << tracker.useful << endl;
+    std::cout << "Number of Late Prefetches: " << tracker.late << endl;
+    std::cout << "Number of Polluting Prefetches: " << tracker.polluting << endl;
+    std::cout << "Number of Unused Prefetches: " << unused + prefetcher.discarded << endl;
+    std::cout << "Prefetch Accuracy: " << (prefetches > 0 ? (double)tracker.useful / prefetches : 0) << endl;
+    std::cout << "Prefetch Coverage: " << (tracker.useful + misses > 0 ? (double)tracker.useful / (tracker.useful + misses) : 0) << endl;
+}
+
+/*
+    Simulate a hierarchy of caches, levels[0] being the first level (the one described by the trace header). Misses of
+    a level are forwarded to the next one as they happen, so the trace is read once. Block addresses in the trace are
+    in blocks of the first level; lower levels must have the same or larger blocks, and an exclusive level the same
+    blocks as the level above it. The lines and statistics of every level are printed as selected by print_result
+    (PRINT_ flags), with the profile of every level if profile is set.
+
+    timing sets the write policy and victim cache of the first level and, if enabled, times every access with a
+    TimingModel: which level served a miss is seen from the hits of the victim cache and of the lower levels, and the
+    dirty victims of the first level from its writebacks. The timing statistics are printed after those of the levels.
+
+    prefetch, if set, puts a Prefetcher in front of the first level (see prefetcher.h). Prefetches are filled after the
+    access that asked for them and are ready once the level that served them would have, counting from the end of
+    that access; their outcome is printed after the statistics of the levels. They are timed with the latencies of
+    timing even when it is not enabled, to tell the late prefetches, and their writebacks are off the critical path.
+*/
+template <class Policy, class TraceReader>
+int hierarchy_sim(const vector<LevelConfig> &levels, int inclusion, TraceReader &trace, vector<CacheStats> &stats, int print_result, bool profile = false,
+                  const TimingConfig *timing = NULL, const PrefetchConfig *prefetch = NULL)
+{
+    vector<Cache<Policy> *> caches;
+    for (size_t l = 0; l < levels.size(); l++)
+    {
+        const LevelConfig &level = levels[l];
+        if (!check_parameters(level.cache_size, level.cache_block_size, level.cache_associativity) ||
+            (l > 0 && level.cache_block_size < levels[l - 1].cache_block_size) ||
+            (l > 0 && inclusion == INCLUSION_EXCLUSIVE && level.cache_block_size != levels[l - 1].cache_block_size))
+        {
+            cout << "Invalid parameters for L" << l + 1 << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        int total_sets = level.cache_size / level.cache_block_size / level.cache_associativity;
+        int block_words = level.cache_block_size / levels[0].cache_block_size;
+        caches.push_back(new Cache<Policy>(total_sets, level.cache_associativity, level.T, 0, -1, block_words));
+        if (profile)
+        {
+            caches[l]->enable_profile();
+        }
+        if (l > 0)
+        {
+            caches[l - 1]->attach(caches[l], inclusion);
+        }
+    }
+
+    TimingConfig untimed;
+    if (timing == NULL)
+    {
+        timing = &untimed;
+    }
+    caches[0]->set_write_policy(timing->write_policy, timing->write_allocate);
+    if (timing->victim_cache > 0)
+    {
+        caches[0]->enable_victim_cache(timing->victim_cache);
+    }
+    const VictimCache *victims = caches[0]->victim_cache();
+    unique_ptr<Prefetcher> prefetcher;
+    unique_ptr<PrefetchTracker> tracker;
+    if (prefetch != NULL && prefetch->kind != PREFETCH_NONE)
+    {
+        prefetcher.reset(new_prefetcher(prefetch->kind, prefetch->degree, prefetch->buffers));
+        tracker.reset(new PrefetchTracker(levels[0].cache_size / levels[0].cache_block_size));
+        caches[0]->enable_prefetch();
+    }
+    unique_ptr<TimingModel> timer;
+    if (timing->enabled || prefetcher)
+    {
+        timer.reset(new TimingModel(timing->latencies, timing->write_buffer, timing->mshrs));
+    }
+
+    long long int inst_count = 0;
+    Access inst;
+    vector<long long int> lower_hits(caches.size());
+    long long int victim_hits = 0;
+    // take the hits of the victim cache and the lower levels, then the level whose hit ended the fetch since (the number
+    // of levels for main memory)
+    auto take_lower_hits = [&]()
+    {
+        victim_hits = victims ? victims->hits : 0;
+        for (size_t l = 1; l < caches.size(); l++)
+        {
+            lower_hits[l] = caches[l]->stats.read_hits + caches[l]->stats.write_hits;
+        }
+    };
+    auto served_level = [&]()
+    {
+        if (victims && victims->hits != victim_hits)
+        {
+            return TIMING_VICTIM_CACHE;
+        }
+        for (size_t l = 1; l < caches.size(); l++)
+        {
+            if (caches[l]->stats.read_hits + caches[l]->stats.write_hits != lower_hits[l])
+            {
+                return (int)l;
+            }
+        }
+        return (int)caches.size();
+    };
+    // fill a prefetch of block into the first level, its fetch having started at cycle issued
+    auto fill_prefetch = [&](uint64_t block, long long int issued)
+    {
+        take_lower_hits();
+        uint64_t victim;
+        bool filled = caches[0]->prefetch(block, inst_count, victim);
+        if (filled)
+        {
+            tracker->filled(block, victim, issued + timer->fetch_latency(served_level()));
+        }
+        return filled;
+    };
+    vector<uint64_t> requests;
+    while (trace.next(inst))
+    {
+        if (!timer)
+        {
+            caches[0]->access(inst, inst_count);
+            inst_count += inst.repeat;
+            continue;
+        }
+
+        // every access of a coalesced record has its own latency
+        Access single = inst;
+        single.repeat = 1;
+        for (int k = 0; k < inst.repeat; k++)
+        {
+            long long int issued;
+            if (prefetcher && !caches[0]->cached(single.address) && prefetcher->supplies(single.address, timer->now(), issued))
+            {
+                // a stream buffer hands the block over, and this access is the first use of the prefetch
+                fill_prefetch(single.address, issued);
+            }
+
+            long long int writebacks = caches[0]->stats.writebacks;
+            long long int prefetch_uses = caches[0]->prefetch_uses;
+            take_lower_hits();
+
+            bool hit = caches[0]->access(single, inst_count) == HIT;
+
+            int served = -1;
+            if (!hit && (single.type == R || timing->write_allocate))
+            {
+                served = served_level();
+            }
+            bool prefetch_use = caches[0]->prefetch_uses != prefetch_uses;
+            long long int ready = tracker ? tracker->demand(single.address, !hit, prefetch_use, timer->now()) : 0;
+            bool written = single.type == W && (timing->write_policy == WRITE_THROUGH || (!hit && !timing->write_allocate));
+            timer->access(single.type, single.address, served, written, caches[0]->stats.writebacks - writebacks, ready);
 
-                if (getline(iss, read_or_write, ','))
+            if (prefetcher)
+            {
+                requests.clear();
+                prefetcher->observe(single.address, !hit, prefetch_use, timer->now(), requests);
+                for (uint64_t block : requests)
                 {
-                    read_or_write.erase(remove(read_or_write.begin(), read_or_write.end(), ' '), read_or_write.end());
-                    if (read_or_write == "R")
-                    {
-                        inst.push_back(R);
-                    }
-                    else if (read_or_write == "W")
+                    if (fill_prefetch(block, timer->now()))
                     {
-                        inst.push_back(W);
+                        tracker->issued++;
                     }
                     else
                     {
-                        cout << "Invalid input" << endl;
-                        exit(EXIT_FAILURE);
+                        tracker->redundant++;
                     }
                 }
+            }
+            inst_count++;
+        }
+    }
 
-                if (getline(iss, write_data, ','))
-                {
-                    inst.push_back(stoll(write_data));
-                }
-                instructions.push_back(inst);
+    stats.clear();
+    for (Cache<Policy> *cache : caches)
+    {
+        // demotions in levels that were not accessed up to the end of the trace
+        cache->advance(inst_count - 1);
+        stats.push_back(cache->stats);
+    }
+
+    for (size_t l = 0; l < caches.size(); l++)
+    {
+        string name = "L" + to_string(l + 1);
+        if (print_result & PRINT_LINES)
+        {
+            std::cout << "******************** " << name << " ***************************" << endl;
+            std::cout << "#Data, Tag, Valid-status(valid=1), dirty-status(dirty=1)" << endl;
+            print_cache_lines(*caches[l]);
+            std::cout << "*****************************************************" << endl;
+        }
+        if (print_result & PRINT_STATS)
+        {
+            print_stats(stats[l], name.c_str());
+            std::cout << "Number of Writebacks: " << stats[l].writebacks << endl;
+            std::cout << "Number of Back-invalidations: " << stats[l].invalidations << endl;
+            if (l == 0 && victims != NULL)
+            {
+                std::cout << "Number of Victim Cache Hits: " << victims->hits << endl;
+                std::cout << "Victim Cache Hit Rate: " << (victims->lookups > 0 ? (double)victims->hits / victims->lookups : 0) << endl;
+                std::cout << "Number of Victim Cache Evictions: " << victims->evictions << endl;
+            }
+            if (profile)
+            {
+                print_profile(*caches[l]->profile());
             }
         }
     }
+    if (prefetcher && (print_result & PRINT_STATS))
+    {
+        print_prefetch(*prefetch, *tracker, *prefetcher, stats[0], caches[0]->prefetch_unused);
+    }
+    if (timing->enabled && (print_result & PRINT_STATS))
+    {
+        print_timing(*timer, inst_count);
+    }
+
+    for (Cache<Policy> *cache : caches)
+    {
+        delete cache;
+    }
+    return 0;
+}
+
+/*
+    Simulate cores first level caches (configured by levels[0]) kept coherent by a snooping bus, in front of the
+    shared levels[1..] (NINE) or main memory. Accesses carry the id of their core and are simulated in trace order.
+    The lines and statistics of every core and shared level are printed as selected by print_result (PRINT_ flags).
+*/
+template <class Policy, class TraceReader>
+int multicore_sim(int cores, const vector<LevelConfig> &levels, int protocol, TraceReader &trace, int print_result)
+{
+    for (size_t l = 0; l < levels.size(); l++)
+    {
+        const LevelConfig &level = levels[l];
+        if (!check_parameters(level.cache_size, level.cache_block_size, level.cache_associativity) ||
+            (l > 0 && level.cache_block_size < levels[l - 1].cache_block_size))
+        {
+            cout << "Invalid parameters for L" << l + 1 << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    vector<Cache<Policy> *> shared_levels;
+    for (size_t l = 1; l < levels.size(); l++)
+    {
+        const LevelConfig &level = levels[l];
+        int total_sets = level.cache_size / level.cache_block_size / level.cache_associativity;
+        shared_levels.push_back(new Cache<Policy>(total_sets, level.cache_associativity, level.T, 0, -1, level.cache_block_size / levels[0].cache_block_size));
+        if (l > 1)
+        {
+            shared_levels[l - 2]->attach(shared_levels[l - 1], INCLUSION_NINE);
+        }
+    }
+
+    CoherenceBus<Policy> bus(protocol);
+    vector<Cache<Policy> *> private_caches;
+    int total_sets = levels[0].cache_size / levels[0].cache_block_size / levels[0].cache_associativity;
+    for (int c = 0; c < cores; c++)
+    {
+        private_caches.push_back(new Cache<Policy>(total_sets, levels[0].cache_associativity, levels[0].T));
+        private_caches[c]->join(&bus);
+        if (!shared_levels.empty())
+        {
+            // a shared level has several levels above it, so it can only be NINE (no back-invalidation)
+            private_caches[c]->attach(shared_levels[0], INCLUSION_NINE);
+        }
+        else
+        {
+            private_caches[c]->share_main_memory(private_caches[0]);
+        }
+    }
+
+    long long int inst_count = 0;
+    Access inst;
+    while (trace.next(inst))
+    {
+        if (inst.core < 0 || inst.core >= cores)
+        {
+            cout << "Invalid core: " << inst.core << endl;
+            exit(EXIT_FAILURE);
+        }
+        private_caches[inst.core]->access(inst, inst_count);
+        inst_count += inst.repeat;
+    }
+
+    for (Cache<Policy> *cache : private_caches)
+    {
+        cache->advance(inst_count - 1);
+    }
+    for (Cache<Policy> *cache : shared_levels)
+    {
+        cache->advance(inst_count - 1);
+    }
+
+    for (int c = 0; c < cores; c++)
+    {
+        string name = "Core " + to_string(c);
+        if (print_result & PRINT_LINES)
+        {
+            std::cout << "******************** " << name << " ***************************" << endl;
+            std::cout << "#Data, Tag, Valid-status(valid=1), dirty-status(dirty=1)" << endl;
+            print_cache_lines(*private_caches[c]);
+            std::cout << "*****************************************************" << endl;
+        }
+        if (print_result & PRINT_STATS)
+        {
+            print_stats(private_caches[c]->stats, name.c_str());
+            const CoherenceStats &coherence = bus.stats[c];
+            std::cout << "Number of Writebacks: " << private_caches[c]->stats.writebacks << endl;
+            std::cout << "Number of Bus Reads: " << coherence.bus_reads << endl;
+            std::cout << "Number of Bus Read Exclusives: " << coherence.bus_read_exclusives << endl;
+            std::cout << "Number of Bus Upgrades: " << coherence.bus_upgrades << endl;
+            std::cout << "Number of Invalidations: " << coherence.invalidations << endl;
+            std::cout << "Number of Coherence Misses: " << coherence.coherence_misses << endl;
+            std::cout << "Number of Cache to Cache Transfers: " << coherence.interventions << endl;
+            std::cout << "Number of Flushes: " << coherence.flushes << endl;
+        }
+    }
+    for (size_t l = 0; l < shared_levels.size(); l++)
+    {
+        string name = "L" + to_string(l + 2);
+        if (print_result & PRINT_LINES)
+        {
+            std::cout << "******************** " << name << " ***************************" << endl;
+            std::cout << "#Data, Tag, Valid-status(valid=1), dirty-status(dirty=1)" << endl;
+            print_cache_lines(*shared_levels[l]);
+            std::cout << "*****************************************************" << endl;
+        }
+        if (print_result & PRINT_STATS)
+        {
+            print_stats(shared_levels[l]->stats, name.c_str());
+            std::cout << "Number of Writebacks: " << shared_levels[l]->stats.writebacks << endl;
+        }
+    }
+
+    for (Cache<Policy> *cache : private_caches)
+    {
+        delete cache;
+    }
+    for (Cache<Policy> *cache : shared_levels)
+    {
+        delete cache;
+    }
+    return 0;
+}
+
+// parse a comma separated list of integers, each of them in the range of an int
+vector<int> parse_int_list(const char *list)
+{
+    vector<int> values;
+    const char *p = list;
+    const char *end = list + strlen(list);
+    long long int value;
+    bool in_range = true;
+    while (parse_integer(p, end, value))
+    {
+        if (value < INT_MIN || value > INT_MAX)
+        {
+            in_range = false;
+            break;
+        }
+        values.push_back((int)value);
+        if (p < end && *p == ',')
+        {
+            p++;
+        }
+    }
+    if (!in_range || p != end || values.empty())
+    {
+        cout << "Invalid list: " << list << endl;
+        exit(EXIT_FAILURE);
+    }
+    return values;
+}
+
+// parse a comma separated list of replacement policy names
+vector<int> parse_policy_list(const char *list)
+{
+    vector<int> policies;
+    const char *p = list;
+    while (true)
+    {
+        const char *end = strchr(p, ',');
+        string name = end != NULL ? string(p, end) : string(p);
+        int policy = find_policy(name.c_str());
+        if (policy == POLICY_COUNT)
+        {
+            cout << "Unknown policy: " << name << endl;
+            exit(EXIT_FAILURE);
+        }
+        policies.push_back(policy);
+
+        if (end == NULL)
+        {
+            return policies;
+        }
+        p = end + 1;
+    }
+}
+
+/*
+    Miss ratio curve of LRU for every power of 2 cache size up to max_cache_size and every power of 2 associativity, from
+    the stack distances of one pass over the trace (see StackDistanceProfile). The same pass simulates policy (a POLICY_
+    constant) at MRC_COMPARED_SIZES of the sizes, spread over the curve, with cache_associativity ways and T, and prints
+    how far its hit ratio is from LRU.
+*/
+template <class TraceReader>
+int miss_ratio_curve(long long int max_cache_size, int cache_block_size, int cache_associativity, int T, int policy, TraceReader &trace)
+{
+    int max_line_bits = __builtin_ctzll(max_cache_size / cache_block_size);
+    StackDistanceProfile distances(max_line_bits);
+
+    // compared caches, from log2 of cache_associativity lines up to the largest
+    vector<int> compared_line_bits;
+    int first_bits = __builtin_ctz(cache_associativity);
+    for (int i = 0; i < MRC_COMPARED_SIZES && first_bits <= max_line_bits; i++)
+    {
+        int bits = first_bits + (max_line_bits - first_bits) * i / (MRC_COMPARED_SIZES - 1);
+        if (compared_line_bits.empty() || compared_line_bits.back() != bits)
+        {
+            compared_line_bits.push_back(bits);
+        }
+    }
+    vector<unique_ptr<CacheSimulator>> compared;
+    for (int bits : compared_line_bits)
+    {
+        compared.emplace_back(new CacheSimulator(cache_block_size << bits, cache_block_size, cache_associativity, T, policy_names[policy]));
+        check_result(compared.back()->status());
+    }
+
+    vector<Access> batch;
+    batch.reserve(CACHE_SIM_BATCH_ACCESSES);
+    Access inst;
+    bool more = true;
+    while (more)
+    {
+        batch.clear();
+        while (batch.size() < CACHE_SIM_BATCH_ACCESSES && (more = trace.next(inst)))
+        {
+            distances.access(inst.address, inst.repeat);
+            batch.push_back(inst);
+        }
+        for (auto &cache : compared)
+        {
+            check_result(cache->access_batch(batch.data(), batch.size()));
+        }
+    }
 
-    cache_sim(cache_size, cache_block_size, cache_associativity, T, instructions);
+    long long int accesses = distances.accesses();
+    std::cout << "LRU miss ratio curve of " << accesses << " accesses to " << distances.blocks() << " blocks" << endl;
+    std::cout << "cache_size, cache_block_size, cache_associativity, hits, misses, miss_ratio" << endl;
+    for (int line_bits = 0; line_bits <= max_line_bits; line_bits++)
+    {
+        for (int way_bits = 0; way_bits <= line_bits; way_bits++)
+        {
+            long long int hits = distances.hits(line_bits - way_bits, 1 << way_bits);
+            std::cout << ((long long int)cache_block_size << line_bits) << ", " << cache_block_size << ", " << (1 << way_bits) << ", " << hits << ", "
+                      << accesses - hits << ", " << (float)(accesses - hits) / accesses << "\n";
+        }
+    }
 
+    std::cout << policy_names[policy] << " (T = " << T << ") against LRU" << endl;
+    std::cout << "cache_size, cache_block_size, cache_associativity, lru_hit_ratio, " << policy_names[policy] << "_hit_ratio, difference" << endl;
+    for (size_t i = 0; i < compared.size(); i++)
+    {
+        const CacheStats &stats = compared[i]->stats();
+        int way_bits = __builtin_ctz(cache_associativity);
+        float lru = (float)distances.hits(compared_line_bits[i] - way_bits, cache_associativity) / accesses;
+        float other = (float)(stats.read_hits + stats.write_hits) / stats.accesses;
+        std::cout << ((long long int)cache_block_size << compared_line_bits[i]) << ", " << cache_block_size << ", " << cache_associativity << ", " << lru << ", "
+                  << other << ", " << other - lru << "\n";
+    }
+    std::cout << flush;
     return 0;
-}
\ No newline at end of file
+}
+
+struct SweepConfig
+{
+    int cache_size;
+    int cache_block_size;
+    int cache_associativity;
+    int T;
+    int policy;
+    CacheStats stats;
+};
+
+// simulate every configuration over one in-memory copy of the trace on a pool of threads and print a results table.
+// Each configuration is one task; idle workers claim the next unstarted one, so long and short runs balance out.
+void sweep(vector<SweepConfig> &configs, const vector<Access> &accesses, int threads)
+{
+    atomic<size_t> next_config(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next_config++; i < configs.size(); i = next_config++)
+        {
+            SweepConfig &config = configs[i];
+            CacheSimulator cache(config.cache_size, config.cache_block_size, config.cache_associativity, config.T, policy_names[config.policy]);
+            cache.access_batch(accesses);
+            config.stats = cache.stats();
+        }
+    };
+
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++)
+    {
+        pool.push_back(thread(worker));
+    }
+    worker();
+    for (auto &t : pool)
+    {
+        t.join();
+    }
+
+    cout << "cache_size, cache_block_size, cache_associativity, T, policy, accesses, read_hits, read_misses, write_hits, write_misses, hit_ratio" << endl;
+    for (auto &config : configs)
+    {
+        CacheStats &stats = config.stats;
+        cout << config.cache_size << ", " << config.cache_block_size << ", " << config.cache_associativity << ", " << config.T << ", " << policy_names[config.policy] << ", "
+             << stats.accesses << ", " << stats.read_hits << ", " << stats.reads - stats.read_hits << ", "
+             << stats.write_hits << ", " << stats.writes - stats.write_hits << ", "
+             << (float)(stats.read_hits + stats.write_hits) / stats.accesses << "\n";
+    }
+    cout << flush;
+}
+
+struct Options
+{
+    bool sweep = false;
+    bool parallel = false;
+    vector<int> cache_sizes;
+    vector<int> cache_block_sizes;
+    vector<int> cache_associativities;
+    vector<int> Ts;
+    vector<int> policies;
+    vector<LevelConfig> lower_levels; // --l2, --l3
+    int inclusion = INCLUSION_NINE;
+    int cores = 1;              // --cores, or 1 + number of --core-trace
+    vector<string> core_traces; // traces of cores 1.. (core 0 is the input file)
+    int protocol = PROTOCOL_MESI;
+    bool profile = false;
+    CheckpointConfig checkpoints;
+    IntervalConfig intervals;
+    int sample_ratio = 0;            // --sample-sets: simulate one set in sample_ratio, 0: all sets
+    int sample_mode = SAMPLE_STRIDE; // --sample-mode
+    bool byte_addresses = false;     // --byte-addresses: the trace has byte addresses
+    int access_size = 0;             // --access-size: bytes of every access of a byte address trace, 0: BYTE_ACCESS_SIZE
+    bool coalesce = false;           // --coalesce: merge runs of identical accesses (see CoalescingTraceReader)
+    bool mrc = false;                // --mrc: LRU miss ratio curve from stack distances
+    TimingConfig timing;             // --timing, --latency, --write-buffer, --mshrs, --write-through, --no-write-allocate, --victim-cache
+    PrefetchConfig prefetch;         // --prefetch, --prefetch-degree, --stream-buffers
+    long long int mrc_max_size = 0;  // --mrc-max-size: largest cache of the curve, 0: MRC_DEFAULT_SCALE times the input file
+    int print = PRINT_STATS | PRINT_LINES; // --no-dump leaves out PRINT_LINES
+    int threads = max(1, (int)thread::hardware_concurrency());
+};
+
+// simulate every combination of the swept parameters over one in-memory copy of the trace
+template <class TraceReader>
+void run_sweep(TraceReader &trace, Options &options, int cache_size, int cache_block_size, int cache_associativity, int T)
+{
+    // parameters that are not swept come from the trace
+    vector<int> cache_sizes = options.cache_sizes.empty() ? vector<int>{cache_size} : options.cache_sizes;
+    vector<int> cache_block_sizes = options.cache_block_sizes.empty() ? vector<int>{cache_block_size} : options.cache_block_sizes;
+    vector<int> cache_associativities = options.cache_associativities.empty() ? vector<int>{cache_associativity} : options.cache_associativities;
+    vector<int> Ts = options.Ts.empty() ? vector<int>{T} : options.Ts;
+    vector<int> policies = options.policies.empty() ? vector<int>{POLICY_PRIORITY_LRU} : options.policies;
+
+    vector<Access> accesses;
+    Access access;
+    while (trace.next(access))
+    {
+        accesses.push_back(access);
+    }
+
+    vector<SweepConfig> configs;
+    for (int size : cache_sizes)
+        for (int block_size : cache_block_sizes)
+            for (int associativity : cache_associativities)
+                for (int t : Ts)
+                    for (int policy : policies)
+                    {
+                        if (check_parameters(size, block_size, associativity))
+                        {
+                            configs.push_back({size, block_size, associativity, t, policy, {}});
+                        }
+                        else
+                        {
+                            cout << "Skipping invalid parameters: " << size << ", " << block_size << ", " << associativity << endl;
+                        }
+                    }
+
+    sweep(configs, accesses, options.threads);
+}
+
+template <class TraceReader>
+void run(TraceReader &trace, Options &options)
+{
+    int cache_size, cache_block_size, cache_associativity, T;
+    trace.read_header(cache_size, cache_block_size, cache_associativity, T);
+
+    if (options.checkpoints.resume_file != NULL)
+    {
+        // the configuration of a resumed simulation comes from its snapshot
+        SnapshotConfig config;
+        check_result(CacheSimulator::read_snapshot_config(options.checkpoints.resume_file, config), options.checkpoints.resume_file);
+        int policy = find_policy(config.policy);
+        if (!options.policies.empty() && options.policies[0] != policy)
+        {
+            cout << "The snapshot was taken with --policy " << config.policy << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (options.byte_addresses && config.cache_block_size != cache_block_size)
+        {
+            cout << "--byte-addresses needs the block size of the snapshot in the input file" << endl;
+            exit(EXIT_FAILURE);
+        }
+        cache_size = config.cache_size;
+        cache_block_size = config.cache_block_size;
+        cache_associativity = config.cache_associativity;
+        T = config.T;
+        options.policies = {policy};
+    }
+
+    if (options.cores > 1)
+    {
+        vector<LevelConfig> levels{{cache_size, cache_block_size, cache_associativity, T}};
+        levels.insert(levels.end(), options.lower_levels.begin(), options.lower_levels.end());
+        with_policy(options.policies.empty() ? POLICY_PRIORITY_LRU : options.policies[0], [&](auto policy)
+                    { multicore_sim<typename decltype(policy)::type>(options.cores, levels, options.protocol, trace, options.print); });
+    }
+    else if (!options.lower_levels.empty() || options.timing.enabled || options.timing.write_policy != WRITE_BACK || !options.timing.write_allocate ||
+             options.timing.victim_cache > 0 || options.prefetch.kind != PREFETCH_NONE)
+    {
+        vector<LevelConfig> levels{{cache_size, cache_block_size, cache_associativity, T}};
+        levels.insert(levels.end(), options.lower_levels.begin(), options.lower_levels.end());
+        bool timed = options.timing.enabled || options.prefetch.kind != PREFETCH_NONE;
+        if (timed && options.timing.latencies.empty())
+        {
+            options.timing.latencies.assign(default_latencies, default_latencies + levels.size());
+            options.timing.latencies.push_back(TIMING_MEMORY_LATENCY);
+        }
+        if (timed && options.timing.latencies.size() != levels.size() + 1)
+        {
+            cout << "--latency needs the latency of every level and of the memory" << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (options.prefetch.degree == 0)
+        {
+            options.prefetch.degree = prefetch_default_degrees[options.prefetch.kind];
+        }
+        vector<CacheStats> stats;
+        with_policy(options.policies.empty() ? POLICY_PRIORITY_LRU : options.policies[0], [&](auto policy)
+                    { hierarchy_sim<typename decltype(policy)::type>(levels, options.inclusion, trace, stats, options.print, options.profile, &options.timing,
+                                                                     &options.prefetch); });
+    }
+    else if (options.mrc)
+    {
+        long long int max_cache_size = options.mrc_max_size > 0 ? options.mrc_max_size : (long long int)cache_size * MRC_DEFAULT_SCALE;
+        if (!check_parameters(cache_size, cache_block_size, cache_associativity) || (max_cache_size & (max_cache_size - 1)) != 0 ||
+            max_cache_size < cache_block_size || max_cache_size / cache_block_size > (1LL << MRC_MAX_LINE_BITS) || max_cache_size > INT_MAX)
+        {
+            cout << "Invalid parameters for --mrc (at most " << (1 << MRC_MAX_LINE_BITS) << " lines)" << endl;
+            exit(EXIT_FAILURE);
+        }
+        miss_ratio_curve(max_cache_size, cache_block_size, cache_associativity, T, options.policies.empty() ? POLICY_PRIORITY_LRU : options.policies[0], trace);
+    }
+    else if (options.sweep)
+    {
+        run_sweep(trace, options, cache_size, cache_block_size, cache_associativity, T);
+    }
+    else if (options.sample_ratio > 0)
+    {
+        with_policy(options.policies.empty() ? POLICY_PRIORITY_LRU : options.policies[0], [&](auto policy)
+                    { sampled_cache_sim<typename decltype(policy)::type>(cache_size, cache_block_size, cache_associativity, T, trace, options.sample_ratio,
+                                                                         options.sample_mode, options.print); });
+    }
+    else if (options.parallel)
+    {
+        CacheStats stats;
+        with_policy(options.policies.empty() ? POLICY_PRIORITY_LRU : options.policies[0], [&](auto policy)
+                    { parallel_cache_sim<typename decltype(policy)::type>(cache_size, cache_block_size, cache_associativity, T, trace, options.threads, stats, options.print); });
+    }
+    else
+    {
+        CacheStats stats;
+        cache_sim(cache_size, cache_block_size, cache_associativity, T, options.policies.empty() ? POLICY_PRIORITY_LRU : options.policies[0], trace, stats, options.print,
+                  options.profile, &options.checkpoints, &options.intervals);
+    }
+}
+
+// run on trace, read as a trace of byte addresses with --byte-addresses and coalesced with --coalesce (with one of
+// them, the reader of the other passes the trace through, so every mode is compiled twice per input format)
+template <class TraceReader>
+void run_trace(TraceReader &trace, Options &options)
+{
+    if (!options.byte_addresses && !options.coalesce)
+    {
+        run(trace, options);
+        return;
+    }
+
+    ByteAddressTraceReader<TraceReader> blocks(trace, options.byte_addresses ? options.access_size : 0);
+    CoalescingTraceReader<ByteAddressTraceReader<TraceReader>> records(blocks, options.coalesce ? COALESCE_MAX_REPEAT : 1);
+    run(records, options);
+    if (options.byte_addresses && (options.print & PRINT_STATS))
+    {
+        std::cout << "Number of Byte Address Accesses: " << blocks.byte_accesses() << endl;
+        std::cout << "Number of Straddling Accesses: " << blocks.straddling_accesses() << endl;
+    }
+}
+
+/*
+    usage: ./a.out {input_file} [--policy name] [--profile] [--parallel] [--threads n] [--no-dump]
+           ./a.out {input_file} [--policy name] [--checkpoint {file} [--checkpoint-every n]] [--resume {file} [--trace-offset n]]
+           ./a.out {input_file} [--policy name] --interval n [--interval-format csv|json] [--interval-file {file}]
+           ./a.out {input_file} [--policy name] --sample-sets n [--sample-mode stride|hash]
+           ./a.out {input_file} --byte-addresses [--access-size n] [any of the above]
+           ./a.out {input_file} --coalesce [any of the above]
+           ./a.out {input_file} --mrc [--mrc-max-size n] [--policy name]
+           ./a.out {input_file} [--write-through] [--no-write-allocate] [--victim-cache n]
+                                [--timing [--latency l1,..,memory] [--write-buffer n] [--mshrs n]] [--l2 ..] [--l3 ..] [--policy name] [--profile]
+           ./a.out {input_file} --prefetch next-line|stride|stream [--prefetch-degree n] [--stream-buffers n] [--timing ..]
+                                [--l2 ..] [--l3 ..] [--policy name] [--profile]
+           ./a.out {input_file} --l2 size,block_size,associativity,T [--l3 size,block_size,associativity,T]
+                                [--inclusion nine|inclusive|exclusive] [--policy name] [--profile]
+           ./a.out {input_file} --cores n [--protocol mesi|moesi] [--l2 ..] [--l3 ..] [--policy name]
+           ./a.out {input_file} --core-trace {file} [--core-trace {file} ..] [--protocol mesi|moesi] [--l2 ..] [--l3 ..]
+           ./a.out {input_file} --sweep [--cache-size a,b,..] [--block-size a,b,..] [--associativity a,b,..] [--T a,b,..]
+                                [--policy a,b,..] [--threads n]
+
+    --policy selects the replacement policy: priority-lru (default, HIGH and LOW PRIORITY groups), lru, plru (tree
+    pseudo-LRU), srrip, brrip or random. T only affects priority-lru.
+    --l2 and --l3 add lower levels below the cache of the input file, with the given inclusion towards the levels
+    above them (nine, non-inclusive non-exclusive, by default).
+    --cores simulates n cores with private caches kept coherent by MESI or MOESI, the core of each access being given
+    by a "<core>:" prefix in the input file. With --core-trace, the input file is the trace of core 0 and every
+    --core-trace adds a core; the cores are interleaved one access at a time. --l2 and --l3 are then shared (nine).
+
+    --profile classifies the misses of every level as compulsory, capacity or conflict and prints per set counters of
+    accesses, misses, evictions and demotions, and the lines with the most conflict misses.
+
+    --checkpoint writes a snapshot of the whole simulation to file at the end of the trace, and every n accesses with
+    --checkpoint-every. --resume continues from a snapshot, with the configuration stored in it: the first
+    --trace-offset accesses of the input file are skipped (by default as many as were simulated before the snapshot).
+
+    --interval writes the hit ratio, read and write misses, writebacks and HIGH PRIORITY occupancy of every n accesses
+    as CSV or JSON, to the standard output or --interval-file; with the standard output, the final cache and statistics
+    go to the standard error. --no-dump leaves the lines of the caches out of the final output, in every mode.
+
+    --sample-sets simulates one set in n only (every n-th set, or the sets with the smallest hashes of their index
+    with --sample-mode hash) and prints the hit ratios of the whole cache estimated from them, with 95% confidence
+    intervals.
+
+    --byte-addresses reads the addresses of the input file as byte addresses of accesses of --access-size bytes (4 by
+    default), decoded into blocks of the block size in the input file; an access that straddles blocks accesses each
+    of them, and the statistics count block accesses.
+
+    --mrc prints the LRU miss ratio of every power of 2 cache size up to --mrc-max-size bytes (16 times the cache of
+    the input file by default) and every power of 2 associativity, from the stack distances of one pass over the
+    trace, and compares it with --policy (priority-lru by default, with T of the input file) at a few of the sizes.
+
+    --write-through writes every write of the first level to the next level at once, and --no-write-allocate leaves
+    write misses out of the first level. --timing adds the cycles of every access (first level hit latency, plus the
+    hit latency of the lower levels a miss reaches and the memory latency) and prints the average memory access time
+    and latency percentiles; --latency gives the latency of every level and of the memory (4,12,40 and 200 by
+    default), and --write-buffer puts a coalescing buffer of n entries in front of the next level for the writes of
+    the first level, which stall when it is full.
+    --victim-cache keeps the last n lines evicted from the first level in a fully associative victim cache that
+    serves the misses on them (in 1 more cycle with --timing). --mshrs makes the first level non-blocking, with n miss
+    status holding registers: accesses go on while misses are outstanding, and accesses to a block being fetched merge
+    into its register.
+
+    --prefetch adds a prefetcher to the first level: tagged next-N-line (next-line, n blocks ahead, 1 by default), a
+    stride detector over the streams of nearby accesses (stride, n strides ahead, 2 by default) or --stream-buffers
+    stream buffers (4 by default) of n blocks (4 by default). Prefetched lines are filled like demand misses and their
+    first demand access is not a reuse. The prefetches issued, redundant (already cached), useful, late (used before
+    they arrive, with the latencies of --timing), polluting (their victims missed again) and unused are printed with
+    the accuracy and coverage of the prefetcher.
+
+    --coalesce merges every run of consecutive accesses to the same block, of the same type (and core), into one record
+    that is looked up once; the results are the same as without it, only faster on traces with such runs.
+
+    With --parallel, the sets of the cache are split among n threads (one per core by default).
+    With --sweep, every combination of the listed parameters is simulated and a results table is printed. Parameters
+    that are not listed are taken from the input file.
+*/
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Enter all arguments" << endl;
+        exit(EXIT_SUCCESS);
+    }
+
+    Options options;
+    for (int i = 2; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--sweep")
+        {
+            options.sweep = true;
+        }
+        else if (arg == "--parallel")
+        {
+            options.parallel = true;
+        }
+        else if (arg == "--profile")
+        {
+            options.profile = true;
+        }
+        else if (arg == "--byte-addresses")
+        {
+            options.byte_addresses = true;
+        }
+        else if (arg == "--timing")
+        {
+            options.timing.enabled = true;
+        }
+        else if (arg == "--write-through")
+        {
+            options.timing.write_policy = WRITE_THROUGH;
+        }
+        else if (arg == "--no-write-allocate")
+        {
+            options.timing.write_allocate = false;
+        }
+        else if (i + 1 < argc && arg == "--latency")
+        {
+            options.timing.latencies = parse_int_list(argv[++i]);
+            for (int latency : options.timing.latencies)
+            {
+                if (latency < 0)
+                {
+                    cout << "Invalid latency: " << latency << endl;
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+        else if (i + 1 < argc && arg == "--prefetch")
+        {
+            options.prefetch.kind = find_prefetcher(argv[++i]);
+            if (options.prefetch.kind == PREFETCH_COUNT)
+            {
+                cout << "Unknown prefetcher: " << argv[i] << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (i + 1 < argc && arg == "--prefetch-degree")
+        {
+            options.prefetch.degree = max(1, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--stream-buffers")
+        {
+            options.prefetch.buffers = max(1, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--mshrs")
+        {
+            options.timing.mshrs = max(0, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--victim-cache")
+        {
+            options.timing.victim_cache = max(0, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--write-buffer")
+        {
+            options.timing.write_buffer = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--mrc")
+        {
+            options.mrc = true;
+        }
+        else if (i + 1 < argc && arg == "--mrc-max-size")
+        {
+            options.mrc_max_size = max(1LL, atoll(argv[++i]));
+        }
+        else if (arg == "--coalesce")
+        {
+            options.coalesce = true;
+        }
+        else if (arg == "--no-dump")
+        {
+            options.print &= ~PRINT_LINES;
+        }
+        else if (i + 1 < argc && arg == "--cache-size")
+        {
+            options.cache_sizes = parse_int_list(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--block-size")
+        {
+            options.cache_block_sizes = parse_int_list(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--associativity")
+        {
+            options.cache_associativities = parse_int_list(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--T")
+        {
+            options.Ts = parse_int_list(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--policy")
+        {
+            options.policies = parse_policy_list(argv[++i]);
+        }
+        else if (i + 1 < argc && (arg == "--l2" || arg == "--l3"))
+        {
+            vector<int> level = parse_int_list(argv[++i]);
+            if (level.size() != 4 || options.lower_levels.size() != (arg == "--l2" ? 0u : 1u))
+            {
+                cout << "Invalid level: " << arg << " " << argv[i] << endl;
+                exit(EXIT_FAILURE);
+            }
+            options.lower_levels.push_back({level[0], level[1], level[2], level[3]});
+        }
+        else if (i + 1 < argc && arg == "--inclusion")
+        {
+            string mode = argv[++i];
+            if (mode == "nine")
+            {
+                options.inclusion = INCLUSION_NINE;
+            }
+            else if (mode == "inclusive")
+            {
+                options.inclusion = INCLUSION_INCLUSIVE;
+            }
+            else if (mode == "exclusive")
+            {
+                options.inclusion = INCLUSION_EXCLUSIVE;
+            }
+            else
+            {
+                cout << "Unknown inclusion: " << mode << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (i + 1 < argc && arg == "--cores")
+        {
+            options.cores = max(1, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--core-trace")
+        {
+            options.core_traces.push_back(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--protocol")
+        {
+            string protocol = argv[++i];
+            if (protocol == "mesi")
+            {
+                options.protocol = PROTOCOL_MESI;
+            }
+            else if (protocol == "moesi")
+            {
+                options.protocol = PROTOCOL_MOESI;
+            }
+            else
+            {
+                cout << "Unknown protocol: " << protocol << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (i + 1 < argc && arg == "--checkpoint")
+        {
+            options.checkpoints.save_file = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--checkpoint-every")
+        {
+            options.checkpoints.every = max(0LL, atoll(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--resume")
+        {
+            options.checkpoints.resume_file = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--trace-offset")
+        {
+            options.checkpoints.trace_offset = max(0LL, atoll(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--interval")
+        {
+            options.intervals.every = max(0LL, atoll(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--interval-file")
+        {
+            options.intervals.file = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--interval-format")
+        {
+            string format = argv[++i];
+            if (format == "csv")
+            {
+                options.intervals.format = INTERVAL_CSV;
+            }
+            else if (format == "json")
+            {
+                options.intervals.format = INTERVAL_JSON;
+            }
+            else
+            {
+                cout << "Unknown interval format: " << format << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (i + 1 < argc && arg == "--access-size")
+        {
+            options.access_size = max(1, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--sample-sets")
+        {
+            options.sample_ratio = max(1, atoi(argv[++i]));
+        }
+        else if (i + 1 < argc && arg == "--sample-mode")
+        {
+            string mode = argv[++i];
+            if (mode == "stride")
+            {
+                options.sample_mode = SAMPLE_STRIDE;
+            }
+            else if (mode == "hash")
+            {
+                options.sample_mode = SAMPLE_HASH;
+            }
+            else
+            {
+                cout << "Unknown sample mode: " << mode << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (i + 1 < argc && arg == "--threads")
+        {
+            options.threads = max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            cout << "Unknown argument: " << arg << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!options.sweep && options.policies.size() > 1)
+    {
+        cout << "Several policies need --sweep" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (!options.core_traces.empty())
+    {
+        options.cores = 1 + options.core_traces.size();
+    }
+    if ((!options.lower_levels.empty() || options.cores > 1) && (options.sweep || options.parallel))
+    {
+        cout << "--l2 and --cores cannot be combined with --sweep or --parallel" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.profile && (options.sweep || options.parallel || options.cores > 1))
+    {
+        cout << "--profile cannot be combined with --sweep, --parallel or --cores" << endl;
+        exit(EXIT_FAILURE);
+    }
+    bool checkpointing = options.checkpoints.save_file != NULL || options.checkpoints.resume_file != NULL;
+    if (checkpointing && (options.sweep || options.parallel || !options.lower_levels.empty() || options.cores > 1 || options.profile))
+    {
+        cout << "--checkpoint and --resume cannot be combined with --sweep, --parallel, --l2, --cores or --profile" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.intervals.every > 0 && (options.sweep || options.parallel || !options.lower_levels.empty() || options.cores > 1))
+    {
+        cout << "--interval cannot be combined with --sweep, --parallel, --l2 or --cores" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.intervals.every == 0 && options.intervals.file != NULL)
+    {
+        cout << "--interval-file needs --interval" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.sample_ratio > 0 && (options.sweep || options.parallel || !options.lower_levels.empty() || options.cores > 1 || options.profile ||
+                                     checkpointing || options.intervals.every > 0))
+    {
+        cout << "--sample-sets cannot be combined with --sweep, --parallel, --l2, --cores, --profile, --checkpoint, --resume or --interval" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.mrc && (options.sweep || options.parallel || !options.lower_levels.empty() || options.cores > 1 || options.profile ||
+                        checkpointing || options.intervals.every > 0 || options.sample_ratio > 0))
+    {
+        cout << "--mrc cannot be combined with --sweep, --parallel, --l2, --cores, --profile, --checkpoint, --resume, --interval or --sample-sets" << endl;
+        exit(EXIT_FAILURE);
+    }
+    bool first_level = options.timing.write_policy != WRITE_BACK || !options.timing.write_allocate || options.timing.victim_cache > 0;
+    if ((options.timing.enabled || first_level) && (options.sweep || options.parallel || options.cores > 1 || options.mrc || options.sample_ratio > 0))
+    {
+        cout << "--timing, --write-through, --no-write-allocate and --victim-cache cannot be combined with --sweep, --parallel, --cores, --mrc or --sample-sets" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if ((options.timing.enabled || first_level) && (checkpointing || options.intervals.every > 0))
+    {
+        cout << "--timing, --write-through, --no-write-allocate and --victim-cache cannot be combined with --checkpoint, --resume or --interval" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if ((!options.timing.latencies.empty() && !options.timing.enabled && options.prefetch.kind == PREFETCH_NONE) ||
+        ((options.timing.write_buffer > 0 || options.timing.mshrs > 0) && !options.timing.enabled))
+    {
+        cout << "--latency needs --timing or --prefetch, and --write-buffer and --mshrs need --timing" << endl;
+        exit(EXIT_FAILURE);
+    }
+    bool prefetching = options.prefetch.kind != PREFETCH_NONE;
+    if (prefetching && (options.sweep || options.parallel || options.cores > 1 || options.mrc || options.sample_ratio > 0 || checkpointing ||
+                        options.intervals.every > 0))
+    {
+        cout << "--prefetch cannot be combined with --sweep, --parallel, --cores, --mrc, --sample-sets, --checkpoint, --resume or --interval" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if ((options.prefetch.degree > 0 || options.prefetch.buffers != PREFETCH_STREAM_BUFFERS) && !prefetching)
+    {
+        cout << "--prefetch-degree and --stream-buffers need --prefetch" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.mrc_max_size > 0 && !options.mrc)
+    {
+        cout << "--mrc-max-size needs --mrc" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.access_size > 0 && !options.byte_addresses)
+    {
+        cout << "--access-size needs --byte-addresses" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.access_size == 0)
+    {
+        options.access_size = BYTE_ACCESS_SIZE;
+    }
+    if (options.byte_addresses && !options.cache_block_sizes.empty())
+    {
+        cout << "--byte-addresses cannot be combined with --block-size" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.sample_ratio > 0 && !check_validity(options.sample_ratio))
+    {
+        cout << "--sample-sets must be a power of 2" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.checkpoints.every > 0 && options.checkpoints.save_file == NULL)
+    {
+        cout << "--checkpoint-every needs --checkpoint" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.checkpoints.trace_offset >= 0 && options.checkpoints.resume_file == NULL)
+    {
+        cout << "--trace-offset needs --resume" << endl;
+        exit(EXIT_FAILURE);
+    }
+#if !CACHE_PROFILE
+    if (options.profile)
+    {
+        cout << "--profile needs a build with CACHE_PROFILE=1" << endl;
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (options.cores > 1 && options.inclusion != INCLUSION_NINE)
+    {
+        cout << "Shared levels can only be nine" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (!options.core_traces.empty())
+    {
+        vector<string> files{argv[1]};
+        files.insert(files.end(), options.core_traces.begin(), options.core_traces.end());
+        bool binary = is_binary_trace(argv[1]);
+        for (const string &file : files)
+        {
+            if (is_binary_trace(file.c_str()) != binary)
+            {
+                cout << "Core traces must all be text or all be binary" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (binary)
+        {
+            vector<BinaryTraceReader *> readers;
+            for (const string &file : files)
+            {
+                readers.push_back(new BinaryTraceReader(file.c_str()));
+            }
+            InterleavedTraceReader<BinaryTraceReader> trace(readers);
+            run_trace(trace, options);
+            for (BinaryTraceReader *reader : readers)
+            {
+                delete reader;
+            }
+        }
+        else
+        {
+            vector<TextTraceReader *> readers;
+            for (const string &file : files)
+            {
+                readers.push_back(new TextTraceReader(file.c_str()));
+            }
+            InterleavedTraceReader<TextTraceReader> trace(readers);
+            run_trace(trace, options);
+            for (TextTraceReader *reader : readers)
+            {
+                delete reader;
+            }
+        }
+    }
+    else if (is_binary_trace(argv[1]))
+    {
+        BinaryTraceReader trace(argv[1]);
+        run_trace(trace, options);
+    }
+    else
+    {
+        TextTraceReader trace(argv[1]);
+        run_trace(trace, options);
+    }
+
+    return 0;
+}
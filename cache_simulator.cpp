@@ -0,0 +1,333 @@
+#include "cache_simulator.h"
+#include "cache.h"
+#include "snapshot.h"
+
+using namespace std;
+
+// identifies the simulation a snapshot belongs to; written at the start of every snapshot
+struct SnapshotHeader
+{
+    int cache_size;
+    int cache_block_size;
+    int cache_associativity;
+    int T;
+    int policy;
+    int debug;                // DEBUG builds also store the test memory
+    long long int inst_count; // accesses simulated before the snapshot
+};
+
+// the cache of one replacement policy behind the policy independent CacheSimulator
+class SimulatorCore
+{
+public:
+    virtual ~SimulatorCore() {}
+    virtual int access(const Access &access, long long int inst_count, long long int *read_result) = 0;
+    virtual long long int access_batch(const Access *accesses, size_t count, long long int inst_count, long long int *read_results) = 0;
+    virtual const CacheStats &stats() const = 0;
+    virtual CacheSet set(int s) = 0;
+    virtual long long int high_priority_lines() = 0;
+    virtual void enable_profile() = 0;
+    virtual const CacheProfile *profile() const = 0;
+    virtual void save(SnapshotWriter &out) const = 0;
+    virtual void load(SnapshotReader &in) = 0;
+};
+
+template <class Policy, int Ways>
+class PolicySimulatorCore : public SimulatorCore
+{
+public:
+    PolicySimulatorCore(int total_sets, int associativity, int T) : cache(total_sets, associativity, T) {}
+
+    int access(const Access &access, long long int inst_count, long long int *read_result) override
+    {
+        return cache.access(access, inst_count, read_result);
+    }
+
+    long long int access_batch(const Access *accesses, size_t count, long long int inst_count, long long int *read_results) override
+    {
+        long long int hits = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            hits += (cache.access(accesses[i], inst_count, read_results != NULL ? read_results + i : NULL) == HIT) + accesses[i].repeat - 1;
+            inst_count += accesses[i].repeat;
+        }
+        return hits;
+    }
+
+    const CacheStats &stats() const override
+    {
+        return cache.stats;
+    }
+
+    CacheSet set(int s) override
+    {
+        return cache.set(s);
+    }
+
+    long long int high_priority_lines() override
+    {
+        long long int lines = 0;
+        for (int s = cache.sets_begin(); s < cache.sets_end(); s++)
+        {
+            lines += cache.set(s).divider;
+        }
+        return lines;
+    }
+
+    void enable_profile() override
+    {
+        cache.enable_profile();
+    }
+
+    const CacheProfile *profile() const override
+    {
+        return cache.profile();
+    }
+
+    void save(SnapshotWriter &out) const override
+    {
+        cache.save(out);
+    }
+
+    void load(SnapshotReader &in) override
+    {
+        cache.load(in);
+    }
+
+private:
+    Cache<Policy, Ways> cache;
+};
+
+static SimulatorCore *new_core(int policy, int cache_size, int cache_block_size, int cache_associativity, int T)
+{
+    int total_sets = cache_size / cache_block_size / cache_associativity;
+    SimulatorCore *core = NULL;
+    with_policy(policy, [&](auto selected)
+                { with_associativity(cache_associativity, [&](auto ways)
+                                     { core = new PolicySimulatorCore<typename decltype(selected)::type, decltype(ways)::value>(total_sets, cache_associativity, T); }); });
+    return core;
+}
+
+CacheSimulator::CacheSimulator(int cache_size, int cache_block_size, int cache_associativity, int T, const char *policy)
+    : cache_size(cache_size), cache_block_size(cache_block_size), cache_associativity(cache_associativity), T(T),
+      policy(policy != NULL ? find_policy(policy) : POLICY_COUNT), error(CACHE_SIM_OK), inst_count(0)
+{
+    if (!check_parameters(cache_size, cache_block_size, cache_associativity))
+    {
+        error = CACHE_SIM_INVALID_PARAMETERS;
+    }
+    else if (this->policy == POLICY_COUNT)
+    {
+        error = CACHE_SIM_UNKNOWN_POLICY;
+    }
+    else
+    {
+        core.reset(new_core(this->policy, cache_size, cache_block_size, cache_associativity, T));
+    }
+}
+
+CacheSimulator::~CacheSimulator() {}
+
+int CacheSimulator::status() const
+{
+    return error;
+}
+
+int CacheSimulator::access(uint64_t address, int type, long long int data, long long int *read_result)
+{
+    if (error != CACHE_SIM_OK)
+    {
+        return error;
+    }
+    if (type != R && type != W)
+    {
+        return CACHE_SIM_INVALID_ACCESS;
+    }
+    return core->access(Access{address, type, data, 0}, inst_count++, read_result);
+}
+
+long long int CacheSimulator::access_batch(const Access *accesses, size_t count, long long int *read_results)
+{
+    if (error != CACHE_SIM_OK)
+    {
+        return error;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((accesses[i].type != R && accesses[i].type != W) || accesses[i].repeat < 1)
+        {
+            return CACHE_SIM_INVALID_ACCESS;
+        }
+    }
+
+    long long int hits = core->access_batch(accesses, count, inst_count, read_results);
+    for (size_t i = 0; i < count; i++)
+    {
+        inst_count += accesses[i].repeat;
+    }
+    return hits;
+}
+
+const CacheStats &CacheSimulator::stats() const
+{
+    static const CacheStats no_stats = CacheStats();
+    return core ? core->stats() : no_stats;
+}
+
+int CacheSimulator::sets() const
+{
+    return error == CACHE_SIM_OK ? cache_size / cache_block_size / cache_associativity : error;
+}
+
+int CacheSimulator::ways() const
+{
+    return error == CACHE_SIM_OK ? cache_associativity : error;
+}
+
+int CacheSimulator::line(int set, int way, CacheLine &line) const
+{
+    if (error != CACHE_SIM_OK)
+    {
+        return error;
+    }
+    if (set < 0 || set >= sets() || way < 0 || way >= ways())
+    {
+        return CACHE_SIM_INVALID_LINE;
+    }
+
+    CacheSet lines = core->set(set);
+    line.data = lines.data[way * lines.words];
+    line.tag = lines.tag[way];
+    line.valid = test_bit(lines.valid, way);
+    line.dirty = test_bit(lines.dirty, way);
+    line.access_time = lines.access_time[way];
+    return CACHE_SIM_OK;
+}
+
+int CacheSimulator::priority_divider(int set) const
+{
+    if (error != CACHE_SIM_OK)
+    {
+        return error;
+    }
+    if (set < 0 || set >= sets())
+    {
+        return CACHE_SIM_INVALID_LINE;
+    }
+    return core->set(set).divider;
+}
+
+long long int CacheSimulator::high_priority_lines() const
+{
+    return error == CACHE_SIM_OK ? core->high_priority_lines() : error;
+}
+
+int CacheSimulator::enable_profile()
+{
+    if (error != CACHE_SIM_OK)
+    {
+        return error;
+    }
+    core->enable_profile();
+    return CACHE_SIM_OK;
+}
+
+const CacheProfile *CacheSimulator::profile() const
+{
+    return core ? core->profile() : NULL;
+}
+
+int CacheSimulator::save(const char *filename) const
+{
+    if (error != CACHE_SIM_OK)
+    {
+        return error;
+    }
+
+    SnapshotWriter out(filename);
+    SnapshotHeader header = {cache_size, cache_block_size, cache_associativity, T, policy, DEBUG, inst_count};
+    out.write_value(header);
+    core->save(out);
+    return out.close() ? CACHE_SIM_OK : CACHE_SIM_SNAPSHOT_WRITE;
+}
+
+int CacheSimulator::load(const char *filename)
+{
+    if (error != CACHE_SIM_OK)
+    {
+        return error;
+    }
+
+    SnapshotReader in(filename);
+    SnapshotHeader header;
+    in.read_value(header);
+    if (!in.ok())
+    {
+        return CACHE_SIM_SNAPSHOT_READ;
+    }
+    if (header.cache_size != cache_size || header.cache_block_size != cache_block_size || header.cache_associativity != cache_associativity ||
+        header.T != T || header.policy != policy || header.debug != DEBUG)
+    {
+        return CACHE_SIM_SNAPSHOT_MISMATCH;
+    }
+
+    // load into a new cache, so a corrupt snapshot leaves the current one untouched
+    unique_ptr<SimulatorCore> loaded(new_core(policy, cache_size, cache_block_size, cache_associativity, T));
+    if (core->profile() != NULL)
+    {
+        loaded->enable_profile();
+    }
+    loaded->load(in);
+    if (!in.finish())
+    {
+        return CACHE_SIM_SNAPSHOT_READ;
+    }
+
+    core.swap(loaded);
+    inst_count = header.inst_count;
+    return CACHE_SIM_OK;
+}
+
+int CacheSimulator::read_snapshot_config(const char *filename, SnapshotConfig &config)
+{
+    SnapshotReader in(filename);
+    SnapshotHeader header;
+    in.read_value(header);
+    if (!in.ok() || header.policy < 0 || header.policy >= POLICY_COUNT)
+    {
+        return CACHE_SIM_SNAPSHOT_READ;
+    }
+
+    config.cache_size = header.cache_size;
+    config.cache_block_size = header.cache_block_size;
+    config.cache_associativity = header.cache_associativity;
+    config.T = header.T;
+    config.policy = policy_names[header.policy];
+    config.accesses = header.inst_count;
+    return CACHE_SIM_OK;
+}
+
+const char *CacheSimulator::error_message(int error)
+{
+    switch (error)
+    {
+    case CACHE_SIM_OK:
+        return "No error";
+    case CACHE_SIM_INVALID_PARAMETERS:
+        return "Invalid parameters";
+    case CACHE_SIM_UNKNOWN_POLICY:
+        return "Unknown policy";
+    case CACHE_SIM_INVALID_ACCESS:
+        return "Invalid access type";
+    case CACHE_SIM_INVALID_LINE:
+        return "Invalid set or way";
+    case CACHE_SIM_SNAPSHOT_READ:
+        return "Corrupt snapshot";
+    case CACHE_SIM_SNAPSHOT_WRITE:
+        return "Could not write snapshot";
+    case CACHE_SIM_SNAPSHOT_MISMATCH:
+        return "The snapshot was taken with another configuration or build";
+    default:
+        return "Unknown error";
+    }
+}
@@ -0,0 +1,138 @@
+#ifndef CACHE_SIMULATOR_H
+#define CACHE_SIMULATOR_H
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+#include "trace_reader.h"
+#include "cache_stats.h"
+#include "cache_profile.h"
+
+// results of CacheSimulator calls; errors are negative
+#define CACHE_SIM_OK 0
+#define CACHE_SIM_INVALID_PARAMETERS -1 // sizes are not powers of 2, or there is not a single set
+#define CACHE_SIM_UNKNOWN_POLICY -2
+#define CACHE_SIM_INVALID_ACCESS -3     // type is neither R nor W, or repeat is not positive
+#define CACHE_SIM_INVALID_LINE -4       // set or way out of range
+#define CACHE_SIM_SNAPSHOT_READ -5      // snapshot missing, unreadable or corrupt
+#define CACHE_SIM_SNAPSHOT_WRITE -6     // snapshot could not be written
+#define CACHE_SIM_SNAPSHOT_MISMATCH -7  // snapshot of another configuration or build
+
+// one line of the cache, see CacheSimulator::line()
+struct CacheLine
+{
+    long long int data;
+    uint64_t tag;
+    bool valid;
+    bool dirty;
+    long long int access_time; // sequence number of the latest access
+};
+
+// configuration stored in a snapshot, see CacheSimulator::read_snapshot_config()
+struct SnapshotConfig
+{
+    int cache_size;
+    int cache_block_size;
+    int cache_associativity;
+    int T;
+    const char *policy;
+    long long int accesses; // simulated before the snapshot
+};
+
+class SimulatorCore;
+
+/*
+    Library interface of the simulator: one write back, write allocate cache (see Cache) with its main memory, built
+    as libcachesim (see README) so tools can drive it without the command line front end. Accesses are numbered in
+    the order they are simulated, which is the time T is counted in.
+
+    Nothing is printed (except by DEBUG builds) and the program is never stopped: calls return an error code
+    (CACHE_SIM_ constants, negative) instead. If the constructor fails, status() tells why and every other call
+    returns the same error.
+
+    The replacement policy is chosen at run time, but the simulation loop of every policy is compiled into the
+    library with the policy calls inlined; access_batch() runs it over many accesses with a single indirect call.
+*/
+class CacheSimulator
+{
+public:
+    // policy is a name accepted by --policy: priority-lru, lru, plru, srrip, brrip or random
+    CacheSimulator(int cache_size, int cache_block_size, int cache_associativity, int T, const char *policy = "priority-lru");
+    ~CacheSimulator();
+
+    CacheSimulator(const CacheSimulator &) = delete;
+    CacheSimulator &operator=(const CacheSimulator &) = delete;
+
+    // CACHE_SIM_OK, or the error of the constructor
+    int status() const;
+
+    // simulate an access to block address; type is R or W, data the word written by W. Returns HIT or MISS, and
+    // stores the word read by R in read_result if it is set.
+    int access(uint64_t address, int type, long long int data = 0, long long int *read_result = NULL);
+
+    // simulate count accesses in order; returns the number of hits, or an error before simulating any of them if one
+    // of the accesses is invalid. read_results, if set, receives the word read by each R access (count entries;
+    // those of W accesses are unspecified). An access with repeat > 1 stands for repeat identical accesses in a row
+    // (see CoalescingTraceReader): all of them are counted and numbered, and the word read is that of the first.
+    long long int access_batch(const Access *accesses, size_t count, long long int *read_results = NULL);
+
+    long long int access_batch(const std::vector<Access> &accesses, long long int *read_results = NULL)
+    {
+        return access_batch(accesses.data(), accesses.size(), read_results);
+    }
+
+#if __cplusplus >= 202002L
+    long long int access_batch(std::span<const Access> accesses, long long int *read_results = NULL)
+    {
+        return access_batch(accesses.data(), accesses.size(), read_results);
+    }
+#endif
+
+    // statistics of all accesses so far (all zero if the constructor failed)
+    const CacheStats &stats() const;
+
+    int sets() const;
+    int ways() const;
+
+    // state of the line at way of set
+    int line(int set, int way, CacheLine &line) const;
+
+    // lines [0, divider) of set are in the HIGH PRIORITY group (priority-lru; 0 for the other policies)
+    int priority_divider(int set) const;
+
+    // lines of all sets in the HIGH PRIORITY group
+    long long int high_priority_lines() const;
+
+    // collect 3C miss classification and per set counters from now on (see cache_profile.h)
+    int enable_profile();
+
+    // NULL unless enable_profile() was called
+    const CacheProfile *profile() const;
+
+    // write the whole state to a snapshot file, or replace it by the one in a snapshot of the same configuration
+    // (see read_snapshot_config()); after a failed load the state is unchanged
+    int save(const char *filename) const;
+    int load(const char *filename);
+
+    // configuration of the simulator that wrote a snapshot
+    static int read_snapshot_config(const char *filename, SnapshotConfig &config);
+
+    // description of an error code
+    static const char *error_message(int error);
+
+private:
+    int cache_size;
+    int cache_block_size;
+    int cache_associativity;
+    int T;
+    int policy;
+    int error;
+    long long int inst_count; // sequence number of the next access
+    std::unique_ptr<SimulatorCore> core;
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef CACHE_STATS_H
+#define CACHE_STATS_H
+
+// result of an access
+#define HIT 1
+#define MISS 0
+
+struct CacheStats
+{
+    long long int accesses;
+    long long int reads;
+    long long int read_hits;
+    long long int writes;
+    long long int write_hits;
+    long long int writebacks;    // dirty lines written to the next level or main memory
+    long long int invalidations; // lines dropped by back-invalidation from an inclusive level below
+};
+
+#endif
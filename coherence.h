@@ -0,0 +1,144 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <vector>
+#include <unordered_set>
+#include <stdint.h>
+
+#define PROTOCOL_MESI 0
+#define PROTOCOL_MOESI 1
+
+// answer of a cache to a snoop
+#define SNOOP_MISS 0     // no copy
+#define SNOOP_HIT 1      // clean copy
+#define SNOOP_FLUSHED 2  // dirty copy, written to the next level
+#define SNOOP_SUPPLIED 3 // dirty copy kept as owner, data sent to the requester (MOESI)
+
+struct CoherenceStats
+{
+    long long int bus_reads;           // BusRd, issued on read misses
+    long long int bus_read_exclusives; // BusRdX, issued on write misses
+    long long int bus_upgrades;        // BusUpgr, issued on write hits to shared lines
+    long long int invalidations;       // lines of this core invalidated by writes of other cores
+    long long int coherence_misses;    // misses on blocks this core lost to such an invalidation
+    long long int interventions;       // snoops answered with data from this core (cache to cache transfers)
+    long long int flushes;             // dirty lines written to the next level because of a snoop
+};
+
+template <class Policy, int Ways>
+class Cache;
+
+/*
+    Snooping bus between the private first level caches of several cores, in front of a shared next level. The
+    MESI state of a line is kept in the cache itself: invalid = !valid, modified = dirty, exclusive = clean and
+    !shared, shared = clean and shared. MOESI adds owned = dirty and shared, so a read miss on a modified line is
+    served by the owner instead of a writeback.
+
+    A miss asks every other cache in core order: a read (BusRd) demotes their copies to shared, flushing or (MOESI)
+    supplying dirty data; a write (BusRdX) invalidates them after flushing dirty data. A write hit on a shared line
+    invalidates the other copies (BusUpgr). Cores are simulated one access at a time in trace order, so every run
+    interleaves them the same way. The caches are the generic ones (not specialized on their associativity).
+*/
+template <class Policy>
+class CoherenceBus
+{
+public:
+    CoherenceBus(int protocol) : protocol(protocol) {}
+
+    // add the next core; returns its id
+    int attach(Cache<Policy, 0> *cache)
+    {
+        caches.push_back(cache);
+        stats.push_back(CoherenceStats());
+        invalidated.push_back(std::unordered_set<uint64_t>());
+        return caches.size() - 1;
+    }
+
+    /*
+        Miss of core on block address. shared is set if another cache keeps a copy. The result is true if the data
+        was supplied by another cache (then it is in data and the next level is not read).
+    */
+    bool miss(int core, uint64_t address, int type, long long int &data, bool &shared, long long int inst_count)
+    {
+        CoherenceStats &requester = stats[core];
+        if (invalidated[core].erase(address) != 0)
+        {
+            requester.coherence_misses++;
+        }
+
+        shared = false;
+        bool supplied = false;
+        if (type == R)
+        {
+            requester.bus_reads++;
+            for (size_t c = 0; c < caches.size(); c++)
+            {
+                if ((int)c == core)
+                {
+                    continue;
+                }
+                int snoop = caches[c]->snoop_read(address, protocol == PROTOCOL_MOESI, data, inst_count);
+                count_snoop(c, snoop);
+                shared |= snoop != SNOOP_MISS;
+                supplied |= snoop == SNOOP_SUPPLIED;
+            }
+        }
+        else
+        {
+            requester.bus_read_exclusives++;
+            invalidate_others(core, address, inst_count);
+        }
+        return supplied;
+    }
+
+    // write hit of core on a shared line
+    void upgrade(int core, uint64_t address, long long int inst_count)
+    {
+        stats[core].bus_upgrades++;
+        invalidate_others(core, address, inst_count);
+    }
+
+    int cores() const
+    {
+        return caches.size();
+    }
+
+    std::vector<CoherenceStats> stats; // per core
+
+private:
+    void invalidate_others(int core, uint64_t address, long long int inst_count)
+    {
+        for (size_t c = 0; c < caches.size(); c++)
+        {
+            if ((int)c == core)
+            {
+                continue;
+            }
+            int snoop = caches[c]->snoop_invalidate(address, inst_count);
+            count_snoop(c, snoop);
+            if (snoop != SNOOP_MISS)
+            {
+                stats[c].invalidations++;
+                invalidated[c].insert(address);
+            }
+        }
+    }
+
+    void count_snoop(int c, int snoop)
+    {
+        if (snoop == SNOOP_FLUSHED)
+        {
+            stats[c].flushes++;
+        }
+        else if (snoop == SNOOP_SUPPLIED)
+        {
+            stats[c].interventions++;
+        }
+    }
+
+    int protocol;
+    std::vector<Cache<Policy, 0> *> caches;
+    std::vector<std::unordered_set<uint64_t>> invalidated; // per core: blocks lost to invalidations and not refetched
+};
+
+#endif
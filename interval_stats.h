@@ -0,0 +1,121 @@
+#ifndef INTERVAL_STATS_H
+#define INTERVAL_STATS_H
+
+#include <string>
+#include <stdio.h>
+#include "cache_stats.h"
+
+#define INTERVAL_CSV 0
+#define INTERVAL_JSON 1
+
+#define INTERVAL_BUFFER_BYTES (1 << 16) // output collected before each write
+
+/*
+    Time series of the statistics of a simulation, one sample per interval of accesses: CSV (a header row, then one
+    row per interval) or JSON (an array of one object per interval). Every sample has the accesses simulated at the
+    end of the interval, the hit ratio of the interval and of all accesses so far, the read misses, write misses and
+    writebacks of the interval, and the share of all lines in the HIGH PRIORITY group at the end of the interval.
+
+    Errors do not stop the program: the first failed write makes ok() false.
+*/
+class IntervalWriter
+{
+public:
+    // filename NULL writes to the standard output; start are the statistics before the first interval
+    IntervalWriter(const char *filename, int format, const CacheStats &start = CacheStats())
+        : format(format), previous(start), samples(0)
+    {
+        file = filename != NULL ? fopen(filename, "w") : stdout;
+        failed = file == NULL;
+        buffer.reserve(INTERVAL_BUFFER_BYTES + 256);
+        buffer += format == INTERVAL_CSV ? "accesses,hit_ratio,cumulative_hit_ratio,read_misses,write_misses,writebacks,high_priority_occupancy\n" : "[";
+    }
+
+    ~IntervalWriter()
+    {
+        close();
+    }
+
+    IntervalWriter(const IntervalWriter &) = delete;
+    IntervalWriter &operator=(const IntervalWriter &) = delete;
+
+    // end the interval at stats (of all accesses so far); nothing is written if no access was simulated since the
+    // previous sample
+    void write(const CacheStats &stats, double high_priority_occupancy)
+    {
+        long long int accesses = stats.accesses - previous.accesses;
+        if (accesses <= 0)
+        {
+            return;
+        }
+
+        long long int hits = stats.read_hits + stats.write_hits - previous.read_hits - previous.write_hits;
+        long long int read_misses = (stats.reads - stats.read_hits) - (previous.reads - previous.read_hits);
+        long long int write_misses = (stats.writes - stats.write_hits) - (previous.writes - previous.write_hits);
+        long long int writebacks = stats.writebacks - previous.writebacks;
+        double hit_ratio = (double)hits / accesses;
+        double cumulative_hit_ratio = (double)(stats.read_hits + stats.write_hits) / stats.accesses;
+
+        char line[256];
+        if (format == INTERVAL_CSV)
+        {
+            snprintf(line, sizeof(line), "%lld,%.6f,%.6f,%lld,%lld,%lld,%.6f\n", stats.accesses, hit_ratio, cumulative_hit_ratio,
+                     read_misses, write_misses, writebacks, high_priority_occupancy);
+        }
+        else
+        {
+            snprintf(line, sizeof(line),
+                     "%s\n{\"accesses\": %lld, \"hit_ratio\": %.6f, \"cumulative_hit_ratio\": %.6f, \"read_misses\": %lld, "
+                     "\"write_misses\": %lld, \"writebacks\": %lld, \"high_priority_occupancy\": %.6f}",
+                     samples > 0 ? "," : "", stats.accesses, hit_ratio, cumulative_hit_ratio, read_misses, write_misses, writebacks,
+                     high_priority_occupancy);
+        }
+        buffer += line;
+        if (buffer.size() >= INTERVAL_BUFFER_BYTES)
+        {
+            flush();
+        }
+
+        previous = stats;
+        samples++;
+    }
+
+    // finish the series; false if it could not be written
+    bool close()
+    {
+        if (file == NULL)
+        {
+            return !failed;
+        }
+
+        if (format == INTERVAL_JSON)
+        {
+            buffer += samples > 0 ? "\n]\n" : "]\n";
+        }
+        flush();
+        failed = (file != stdout ? fclose(file) : fflush(file)) != 0 || failed;
+        file = NULL;
+        return !failed;
+    }
+
+    bool ok() const
+    {
+        return !failed;
+    }
+
+private:
+    void flush()
+    {
+        failed = failed || fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size();
+        buffer.clear();
+    }
+
+    FILE *file;
+    int format;
+    CacheStats previous;
+    long long int samples;
+    std::string buffer;
+    bool failed;
+};
+
+#endif
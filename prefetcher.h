@@ -0,0 +1,345 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PREFETCH_NONE 0
+#define PREFETCH_NEXT_LINE 1 // NextLinePrefetcher
+#define PREFETCH_STRIDE 2    // StridePrefetcher
+#define PREFETCH_STREAM 3    // StreamBuffers
+#define PREFETCH_COUNT 4
+
+// prefetcher names (as accepted by --prefetch), indexed by the PREFETCH_ constants
+static const char *const prefetcher_names[PREFETCH_COUNT] = {"none", "next-line", "stride", "stream"};
+
+// default degree of every prefetcher (--prefetch-degree): blocks ahead, or blocks per stream buffer
+static const int prefetch_default_degrees[PREFETCH_COUNT] = {0, 1, 2, 4};
+
+#define PREFETCH_STREAM_BUFFERS 4  // default --stream-buffers
+#define STRIDE_STREAMS 16          // streams tracked by StridePrefetcher
+#define STRIDE_WINDOW 64           // largest distance, in blocks, from the last access of a stream to one that continues it
+#define STRIDE_MAX_CONFIDENCE 3
+#define STRIDE_CONFIDENT 2         // confidence from which a stream is prefetched
+#define PREFETCH_PRUNE_ENTRIES 4096 // prefetches in flight kept by PrefetchTracker before the arrived ones are dropped
+
+/*
+    A hardware prefetcher of the first level. It sees the demand accesses of the trace after they are simulated and
+    asks for blocks to be prefetched into the cache (Cache::prefetch(), which fills them like the demand misses, in the
+    LOW PRIORITY group with priority-lru). A prefetcher that holds blocks outside the cache (StreamBuffers) also hands
+    them over on the misses it can serve. Blocks are block addresses of the first level.
+*/
+class Prefetcher
+{
+public:
+    virtual ~Prefetcher() {}
+
+    // demand access to block at cycle now: a miss, or the first use of a prefetched line if prefetch_use is set;
+    // appends the blocks to prefetch to requests
+    virtual void observe(uint64_t block, bool miss, bool prefetch_use, long long int now, std::vector<uint64_t> &requests) = 0;
+
+    // true if the prefetcher holds block, which is about to miss at cycle now: it leaves the prefetcher to be filled
+    // into the cache, and issued is the cycle its fetch started
+    virtual bool supplies(uint64_t block, long long int now, long long int &issued)
+    {
+        return false;
+    }
+
+    long long int fetched = 0;   // blocks fetched into buffers of the prefetcher
+    long long int discarded = 0; // of those, dropped without a demand access
+};
+
+/*
+    Tagged next-N-line prefetching: a miss, and the first use of a prefetched line, prefetch the degree blocks that
+    follow it, so a sequential stream keeps being prefetched ahead once it has missed once.
+*/
+class NextLinePrefetcher : public Prefetcher
+{
+public:
+    NextLinePrefetcher(int degree) : degree(degree) {}
+
+    void observe(uint64_t block, bool miss, bool prefetch_use, long long int now, std::vector<uint64_t> &requests) override
+    {
+        if (miss || prefetch_use)
+        {
+            for (int d = 1; d <= degree; d++)
+            {
+                requests.push_back(block + d);
+            }
+        }
+    }
+
+private:
+    int degree;
+};
+
+/*
+    Stride detector over the streams of the trace. Traces have no PC, so a stream is the sequence of accesses that
+    each fall within STRIDE_WINDOW blocks of the previous one: an access continues the nearest stream, or replaces the
+    least recently used one of the STRIDE_STREAMS tracked. A stream learns the distance between its accesses with a
+    saturating confidence, and once it is confident, every access prefetches the degree blocks that follow it at
+    that stride.
+*/
+class StridePrefetcher : public Prefetcher
+{
+public:
+    StridePrefetcher(int degree) : degree(degree), streams(STRIDE_STREAMS), clock(0) {}
+
+    void observe(uint64_t block, bool miss, bool prefetch_use, long long int now, std::vector<uint64_t> &requests) override
+    {
+        Stream *stream = NULL;
+        for (Stream &candidate : streams)
+        {
+            if (candidate.used > 0 && llabs((long long int)(block - candidate.last)) <= STRIDE_WINDOW &&
+                (stream == NULL || llabs((long long int)(block - candidate.last)) < llabs((long long int)(block - stream->last))))
+            {
+                stream = &candidate;
+            }
+        }
+        clock++;
+        if (stream == NULL)
+        {
+            stream = &*std::min_element(streams.begin(), streams.end(), [](const Stream &a, const Stream &b) { return a.used < b.used; });
+            *stream = {block, 0, 0, clock};
+            return;
+        }
+
+        long long int stride = block - stream->last;
+        stream->used = clock;
+        if (stride == 0)
+        {
+            return;
+        }
+        stream->last = block;
+        if (stride == stream->stride)
+        {
+            stream->confidence = std::min(stream->confidence + 1, STRIDE_MAX_CONFIDENCE);
+        }
+        else if (stream->confidence > 0)
+        {
+            stream->confidence--;
+        }
+        else
+        {
+            stream->stride = stride;
+        }
+
+        if (stream->confidence >= STRIDE_CONFIDENT)
+        {
+            for (int d = 1; d <= degree; d++)
+            {
+                uint64_t target = block + stride * d;
+                if ((stride > 0) == (target > block))
+                {
+                    requests.push_back(target);
+                }
+            }
+        }
+    }
+
+private:
+    struct Stream
+    {
+        uint64_t last;            // block of the latest access
+        long long int stride;
+        int confidence;
+        long long int used;       // clock of the latest access, 0 for a free entry
+    };
+
+    int degree;
+    std::vector<Stream> streams;
+    long long int clock;
+};
+
+/*
+    Stream buffers (Jouppi): FIFOs of the depth blocks that follow a miss, fetched when the miss allocates the least
+    recently used buffer. A later miss on a block of a buffer takes it (dropping the blocks before it) and the buffer
+    fetches more to stay depth blocks ahead; the blocks that are taken move into the cache. They are read from the
+    next level when they move, but arrive by the cycle their fetch started plus the latency of that read.
+*/
+class StreamBuffers : public Prefetcher
+{
+public:
+    StreamBuffers(int buffers, int depth) : depth(depth), buffers(buffers), clock(0) {}
+
+    void observe(uint64_t block, bool miss, bool prefetch_use, long long int now, std::vector<uint64_t> &requests) override
+    {
+        if (!miss)
+        {
+            return;
+        }
+
+        Buffer &buffer = *std::min_element(buffers.begin(), buffers.end(), [](const Buffer &a, const Buffer &b) { return a.used < b.used; });
+        discarded += buffer.entries.size();
+        buffer.entries.clear();
+        buffer.next = block + 1;
+        buffer.used = ++clock;
+        refill(buffer, now);
+    }
+
+    bool supplies(uint64_t block, long long int now, long long int &issued) override
+    {
+        for (Buffer &buffer : buffers)
+        {
+            for (size_t e = 0; e < buffer.entries.size(); e++)
+            {
+                if (buffer.entries[e].block == block)
+                {
+                    issued = buffer.entries[e].issued;
+                    discarded += e;
+                    buffer.entries.erase(buffer.entries.begin(), buffer.entries.begin() + e + 1);
+                    buffer.used = ++clock;
+                    refill(buffer, now);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t block;
+        long long int issued; // cycle its fetch started
+    };
+
+    struct Buffer
+    {
+        std::deque<Entry> entries;
+        uint64_t next = 0;      // block fetched after the last entry
+        long long int used = 0; // clock of the latest allocation or hit
+    };
+
+    void refill(Buffer &buffer, long long int now)
+    {
+        while ((int)buffer.entries.size() < depth)
+        {
+            buffer.entries.push_back({buffer.next++, now});
+            fetched++;
+        }
+    }
+
+    int depth;
+    std::vector<Buffer> buffers;
+    long long int clock;
+};
+
+// prefetcher of kind (PREFETCH_ constant other than PREFETCH_NONE); degree and buffers as in --prefetch-degree and --stream-buffers
+static inline Prefetcher *new_prefetcher(int kind, int degree, int buffers)
+{
+    switch (kind)
+    {
+    case PREFETCH_NEXT_LINE:
+        return new NextLinePrefetcher(degree);
+    case PREFETCH_STRIDE:
+        return new StridePrefetcher(degree);
+    default:
+        return new StreamBuffers(buffers, degree);
+    }
+}
+
+// PREFETCH_ constant of a prefetcher name, PREFETCH_COUNT if there is none
+static inline int find_prefetcher(const char *name)
+{
+    for (int kind = 0; kind < PREFETCH_COUNT; kind++)
+    {
+        if (strcmp(prefetcher_names[kind], name) == 0)
+        {
+            return kind;
+        }
+    }
+    return PREFETCH_COUNT;
+}
+
+/*
+    Outcome of the prefetches filled into a cache. A prefetch is useful if its line gets a demand access before it is
+    evicted, and late if that access comes before the cycle the prefetch is ready. A demand miss on a block that a
+    prefetch evicted counts as polluting; the victims are remembered up to remembered_victims of them (the lines of
+    the cache: an older victim would likely have been evicted anyway).
+*/
+class PrefetchTracker
+{
+public:
+    PrefetchTracker(size_t remembered_victims)
+        : issued(0), redundant(0), useful(0), late(0), polluting(0), remembered_victims(remembered_victims), evictions(0)
+    {
+    }
+
+    // a prefetch filled block, ready at cycle ready, evicting the valid line of block address victim (UINT64_MAX if none)
+    void filled(uint64_t block, uint64_t victim, long long int ready)
+    {
+        in_flight[block] = ready;
+        victims.erase(block);
+        if (victim == UINT64_MAX)
+        {
+            return;
+        }
+
+        victims[victim] = ++evictions;
+        order.push_back({victim, evictions});
+        if (order.size() > remembered_victims)
+        {
+            auto oldest = victims.find(order.front().first);
+            if (oldest != victims.end() && oldest->second == order.front().second)
+            {
+                victims.erase(oldest);
+            }
+            order.pop_front();
+        }
+    }
+
+    // demand access to block at cycle now (see Prefetcher::observe()); returns the cycle it waits for if it used a
+    // prefetch still in flight, 0 otherwise
+    long long int demand(uint64_t block, bool miss, bool prefetch_use, long long int now)
+    {
+        long long int ready = 0;
+        if (prefetch_use)
+        {
+            useful++;
+            auto found = in_flight.find(block);
+            if (found != in_flight.end())
+            {
+                if (found->second > now)
+                {
+                    late++;
+                    ready = found->second;
+                }
+                in_flight.erase(found);
+            }
+        }
+        if (miss && victims.erase(block))
+        {
+            polluting++;
+        }
+
+        if (in_flight.size() > PREFETCH_PRUNE_ENTRIES)
+        {
+            for (auto entry = in_flight.begin(); entry != in_flight.end();)
+            {
+                entry = entry->second <= now ? in_flight.erase(entry) : std::next(entry);
+            }
+        }
+        return ready;
+    }
+
+    long long int issued;    // prefetches filled into the cache
+    long long int redundant; // requests for blocks already cached
+    long long int useful;
+    long long int late;
+    long long int polluting;
+
+private:
+    std::unordered_map<uint64_t, long long int> in_flight; // cycle each prefetched line not used yet is ready
+    std::unordered_map<uint64_t, long long int> victims;   // blocks evicted by prefetches, by eviction number
+    std::deque<std::pair<uint64_t, long long int>> order;  // victims in eviction order
+    size_t remembered_victims;
+    long long int evictions;
+};
+
+#endif
@@ -0,0 +1,560 @@
+#ifndef REPLACEMENT_POLICY_H
+#define REPLACEMENT_POLICY_H
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include "cache_sets.h"
+#include "cache_profile.h"
+
+#define NO_DEADLINE LLONG_MAX // set without HIGH PRIORITY lines; any real deadline, even with T < 0, is smaller
+
+/*
+    Replacement policies. Cache takes one as a template parameter, so the policy calls are inlined into the access
+    path. Every policy has the same interface, with set indices local to the CacheSets it was built for:
+
+        Policy(CacheSets &lines, int T)
+        int hit(CacheSet &set, int s, int way, long long now)  line at way was hit; returns its way afterwards
+        int victim(CacheSet &set, int s, long long now)        set is full: returns the way holding the line to
+                                                               evict, which receives the new block
+        void fill(CacheSet &set, int s, int way, long long now) new block was loaded into way
+        void invalidate(CacheSet &set, int s, int way)         line at way was invalidated (back-invalidation,
+                                                               or handed to an exclusive level above)
+        void accessed(int s, long long now)                    the access at now to set s is complete
+        void advance(long long now)                            apply time driven updates due up to access now
+        void count_demotions(long long *per_set)               add the lines demoted by advance() to per_set[s]
+                                                               (policies without demotion ignore it)
+        void save(SnapshotWriter &out)                         write the state of the policy (checkpoints)
+        void load(SnapshotReader &in)                          read it back into a policy of the same geometry
+
+    The cache keeps the latest access time of every line itself. Associativity is a power of 2 (check_parameters).
+*/
+
+// mix an access sequence number into a pseudo random number; victims chosen from it do not depend on how the sets
+// are split among threads
+static inline uint64_t mix_sequence_number(long long int now)
+{
+    uint64_t z = (uint64_t)now + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+    HIGH and LOW PRIORITY groups (see README). Lines [0, divider) are in the HIGH PRIORITY group. A hit in the LOW
+    PRIORITY group moves the line to the HIGH PRIORITY group, lines of the HIGH PRIORITY group not accessed for T
+    accesses move back, and the victim is the LRU line of the LOW PRIORITY group, or of the whole set if it is empty.
+
+    Demotion is event driven: each set with HIGH PRIORITY lines is queued under the earliest access count at which one
+    of them can have gone T accesses without being touched (min of latest access time + T), and only sets whose
+    deadline has been reached are scanned. Queue entries whose deadline no longer matches set_demotion_deadline are
+    stale and skipped.
+*/
+class PriorityLruPolicy
+{
+public:
+    PriorityLruPolicy(CacheSets &lines, int T) : lines(lines), T(T), set_demotion_deadline(lines.sets(), NO_DEADLINE), demotions(NULL) {}
+
+    int hit(CacheSet &set, int s, int way, long long int now)
+    {
+        if (way >= set.divider)
+        {
+            // hit in low priority group => move to high priority group
+            swap_lines(set, set.divider, way);
+            way = set.divider;
+            set.divider++;
+        }
+        return way;
+    }
+
+    int victim(CacheSet &set, int s, long long int now)
+    {
+        // LRU from low priority group, if low priority group is empty (i.e. all blocks are high priority) then LRU in
+        // high priority group
+        int ways = lines.ways();
+        if (set.divider < ways)
+        {
+            return least_recent_line(set.access_time, set.divider, ways);
+        }
+
+        // replaced in high priority group: the new line goes to the low priority group
+        int LRU_index = least_recent_line(set.access_time, 0, ways);
+        set.divider--;
+        swap_lines(set, LRU_index, set.divider);
+        return set.divider;
+    }
+
+    void fill(CacheSet &set, int s, int way, long long int now) {}
+
+    void invalidate(CacheSet &set, int s, int way)
+    {
+        if (way < set.divider)
+        {
+            // an invalid line does not stay in the high priority group
+            swap_lines(set, way, set.divider - 1);
+            set.divider--;
+        }
+    }
+
+    void accessed(int s, long long int now)
+    {
+        schedule_demotion(s, now);
+        advance(now);
+    }
+
+    // move lines to the low priority group if not accessed for T cache accesses, for every check due at or before now
+    void advance(long long int inst_count)
+    {
+        while (!demotion_queue.empty() && demotion_queue.top().first <= inst_count)
+        {
+            long long int now = demotion_queue.top().first;
+            int i = demotion_queue.top().second;
+            demotion_queue.pop();
+
+            if (now != set_demotion_deadline[i])
+            {
+                continue; // stale entry
+            }
+            set_demotion_deadline[i] = NO_DEADLINE;
+
+            CacheSet expiring = lines.set(i);
+            for (int j = 0; j < lines.ways(); j++)
+            {
+                if (j < expiring.divider && now - expiring.access_time[j] >= T)
+                {
+#if CACHE_PROFILE
+                    if (demotions != NULL)
+                    {
+                        demotions[i]++;
+                    }
+#endif
+                    swap_lines(expiring, expiring.divider - 1, j);
+                    expiring.divider -= 1;
+                }
+            }
+
+            // a line swapped into an already scanned position is only checked at the next access
+            schedule_demotion(i, now + 1);
+        }
+    }
+
+    void count_demotions(long long int *per_set)
+    {
+        demotions = per_set;
+    }
+
+    void save(SnapshotWriter &out) const
+    {
+        out.write_vector(set_demotion_deadline);
+    }
+
+    // the queue is rebuilt from the deadlines; stale entries never affect the order of the valid ones
+    void load(SnapshotReader &in)
+    {
+        in.read_vector(set_demotion_deadline);
+        demotion_queue = decltype(demotion_queue)();
+        for (size_t s = 0; s < set_demotion_deadline.size(); s++)
+        {
+            if (set_demotion_deadline[s] != NO_DEADLINE)
+            {
+                demotion_queue.push({set_demotion_deadline[s], (int)s});
+            }
+        }
+    }
+
+private:
+    // queue the next demotion check of a set, not earlier than access not_before
+    void schedule_demotion(int s, long long int not_before)
+    {
+        CacheSet scheduled = lines.set(s);
+        long long int deadline = NO_DEADLINE;
+        for (int j = 0; j < scheduled.divider; j++)
+        {
+            long long int line_deadline = scheduled.access_time[j] + T;
+            if (line_deadline < deadline)
+            {
+                deadline = line_deadline;
+            }
+        }
+        if (deadline != NO_DEADLINE && deadline < not_before)
+        {
+            deadline = not_before;
+        }
+
+        long long int &current = set_demotion_deadline[s];
+        if (deadline != current)
+        {
+            current = deadline;
+            if (deadline != NO_DEADLINE)
+            {
+                demotion_queue.push({deadline, s});
+            }
+        }
+    }
+
+    CacheSets &lines;
+    int T;
+    std::vector<long long int> set_demotion_deadline;
+    std::priority_queue<std::pair<long long int, int>, std::vector<std::pair<long long int, int>>, std::greater<std::pair<long long int, int>>> demotion_queue;
+    long long int *demotions; // per set, NULL: not counted
+};
+
+// Plain LRU. Each set keeps its valid lines in a doubly linked recency list (most recent first), so a hit and the
+// victim are O(1) instead of a scan of the access times.
+class LruPolicy
+{
+public:
+    LruPolicy(CacheSets &lines, int T)
+        : ways(lines.ways()), previous(lines.sets() * (size_t)ways, -1), next(lines.sets() * (size_t)ways, -1), head(lines.sets(), -1), tail(lines.sets(), -1)
+    {
+    }
+
+    int hit(CacheSet &set, int s, int way, long long int now)
+    {
+        if (head[s] != way)
+        {
+            unlink(s, way);
+            push_front(s, way);
+        }
+        return way;
+    }
+
+    int victim(CacheSet &set, int s, long long int now)
+    {
+        int way = tail[s];
+        unlink(s, way);
+        return way;
+    }
+
+    void fill(CacheSet &set, int s, int way, long long int now)
+    {
+        push_front(s, way);
+    }
+
+    void invalidate(CacheSet &set, int s, int way)
+    {
+        // the victim of a replacement in progress is already unlinked
+        if (head[s] == way || previous[(size_t)s * ways + way] != -1)
+        {
+            unlink(s, way);
+        }
+    }
+
+    void accessed(int s, long long int now) {}
+
+    void advance(long long int now) {}
+
+    void count_demotions(long long int *per_set) {}
+
+    void save(SnapshotWriter &out) const
+    {
+        out.write_vector(previous);
+        out.write_vector(next);
+        out.write_vector(head);
+        out.write_vector(tail);
+    }
+
+    void load(SnapshotReader &in)
+    {
+        in.read_vector(previous);
+        in.read_vector(next);
+        in.read_vector(head);
+        in.read_vector(tail);
+    }
+
+private:
+    void unlink(int s, int way)
+    {
+        size_t base = (size_t)s * ways;
+        int before = previous[base + way];
+        int after = next[base + way];
+        (before != -1 ? next[base + before] : head[s]) = after;
+        (after != -1 ? previous[base + after] : tail[s]) = before;
+        previous[base + way] = -1;
+        next[base + way] = -1;
+    }
+
+    void push_front(int s, int way)
+    {
+        size_t base = (size_t)s * ways;
+        previous[base + way] = -1;
+        next[base + way] = head[s];
+        (head[s] != -1 ? previous[base + head[s]] : tail[s]) = way;
+        head[s] = way;
+    }
+
+    int ways;
+    std::vector<int> previous; // per line (-1 also for lines not in the list): next more recently used line of its set, -1 for the most recent
+    std::vector<int> next;     // per line: next less recently used line of its set, -1 for the least recent
+    std::vector<int> head;     // per set: most recently used line
+    std::vector<int> tail;     // per set: least recently used line
+};
+
+/*
+    Tree pseudo-LRU. Each set has a binary tree of ways - 1 bits over its lines, stored heap ordered from bit 1; a bit
+    points to the half that was used less recently. An access flips the bits on the path to its line away from it and
+    the victim is found by following the bits from the root, both O(log ways).
+*/
+class TreePlruPolicy
+{
+public:
+    TreePlruPolicy(CacheSets &lines, int T)
+        : levels(__builtin_ctz(lines.ways())), words((lines.ways() + 63) / 64), bits(lines.sets() * (size_t)words)
+    {
+    }
+
+    int hit(CacheSet &set, int s, int way, long long int now)
+    {
+        touch(s, way);
+        return way;
+    }
+
+    int victim(CacheSet &set, int s, long long int now)
+    {
+        uint64_t *tree = &bits[(size_t)s * words];
+        int node = 1;
+        for (int level = 0; level < levels; level++)
+        {
+            node = 2 * node + test_bit(tree, node);
+        }
+        return node - (1 << levels);
+    }
+
+    void fill(CacheSet &set, int s, int way, long long int now)
+    {
+        touch(s, way);
+    }
+
+    void invalidate(CacheSet &set, int s, int way) {}
+
+    void accessed(int s, long long int now) {}
+
+    void advance(long long int now) {}
+
+    void count_demotions(long long int *per_set) {}
+
+    void save(SnapshotWriter &out) const
+    {
+        out.write_vector(bits);
+    }
+
+    void load(SnapshotReader &in)
+    {
+        in.read_vector(bits);
+    }
+
+private:
+    void touch(int s, int way)
+    {
+        uint64_t *tree = &bits[(size_t)s * words];
+        int node = 1;
+        for (int level = levels - 1; level >= 0; level--)
+        {
+            int side = (way >> level) & 1;
+            assign_bit(tree, node, !side);
+            node = 2 * node + side;
+        }
+    }
+
+    int levels;
+    int words;
+    std::vector<uint64_t> bits;
+};
+
+/*
+    Re-reference interval prediction with 2-bit RRPVs (Jaleel et al., ISCA 2010). Hits set the RRPV to 0, the victim
+    is the first line with RRPV 3 after aging the set until there is one. SRRIP inserts new lines with RRPV 2; BRRIP
+    (bimodal) with RRPV 3 and only one fill in BRRIP_LONG_INTERVAL with 2.
+
+    The RRPVs of a set are stored as two bit planes (high and low bit of every line), so finding a line with RRPV 3 is
+    a count-trailing-zeros of high & low and aging all lines by one is a bitwise add on the planes.
+*/
+#define BRRIP_LONG_INTERVAL 32
+
+template <bool bimodal>
+class RripPolicy
+{
+public:
+    RripPolicy(CacheSets &lines, int T)
+        : ways(lines.ways()), words((lines.ways() + 63) / 64), high(lines.sets() * (size_t)words), low(lines.sets() * (size_t)words)
+    {
+    }
+
+    int hit(CacheSet &set, int s, int way, long long int now)
+    {
+        assign_rrpv(s, way, 0);
+        return way;
+    }
+
+    int victim(CacheSet &set, int s, long long int now)
+    {
+        uint64_t *h = &high[(size_t)s * words];
+        uint64_t *l = &low[(size_t)s * words];
+        for (;;)
+        {
+            for (int w = 0; w < words; w++)
+            {
+                uint64_t distant = h[w] & l[w] & word_mask(w);
+                if (distant != 0)
+                {
+                    return w * 64 + __builtin_ctzll(distant);
+                }
+            }
+
+            // no line with RRPV 3, so adding 1 to every RRPV cannot overflow
+            for (int w = 0; w < words; w++)
+            {
+                h[w] ^= l[w];
+                l[w] = ~l[w] & word_mask(w);
+            }
+        }
+    }
+
+    void fill(CacheSet &set, int s, int way, long long int now)
+    {
+        bool distant = bimodal && mix_sequence_number(now) % BRRIP_LONG_INTERVAL != 0;
+        assign_rrpv(s, way, distant ? 3 : 2);
+    }
+
+    void invalidate(CacheSet &set, int s, int way)
+    {
+        assign_rrpv(s, way, 3);
+    }
+
+    void accessed(int s, long long int now) {}
+
+    void advance(long long int now) {}
+
+    void count_demotions(long long int *per_set) {}
+
+    void save(SnapshotWriter &out) const
+    {
+        out.write_vector(high);
+        out.write_vector(low);
+    }
+
+    void load(SnapshotReader &in)
+    {
+        in.read_vector(high);
+        in.read_vector(low);
+    }
+
+private:
+    void assign_rrpv(int s, int way, int rrpv)
+    {
+        assign_bit(&high[(size_t)s * words], way, rrpv & 2);
+        assign_bit(&low[(size_t)s * words], way, rrpv & 1);
+    }
+
+    uint64_t word_mask(int w) const
+    {
+        int n = ways - w * 64;
+        return n >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+    }
+
+    int ways;
+    int words;
+    std::vector<uint64_t> high;
+    std::vector<uint64_t> low;
+};
+
+typedef RripPolicy<false> SrripPolicy;
+typedef RripPolicy<true> BrripPolicy;
+
+// Random replacement. The victim is derived from the access sequence number, so runs are reproducible.
+class RandomPolicy
+{
+public:
+    RandomPolicy(CacheSets &lines, int T) : ways(lines.ways()) {}
+
+    int hit(CacheSet &set, int s, int way, long long int now)
+    {
+        return way;
+    }
+
+    int victim(CacheSet &set, int s, long long int now)
+    {
+        return mix_sequence_number(now) & (ways - 1);
+    }
+
+    void fill(CacheSet &set, int s, int way, long long int now) {}
+
+    void invalidate(CacheSet &set, int s, int way) {}
+
+    void accessed(int s, long long int now) {}
+
+    void advance(long long int now) {}
+
+    void count_demotions(long long int *per_set) {}
+
+    void save(SnapshotWriter &out) const {}
+
+    void load(SnapshotReader &in) {}
+
+private:
+    int ways;
+};
+
+// run time selection of a policy
+#define POLICY_PRIORITY_LRU 0
+#define POLICY_LRU 1
+#define POLICY_TREE_PLRU 2
+#define POLICY_SRRIP 3
+#define POLICY_BRRIP 4
+#define POLICY_RANDOM 5
+#define POLICY_COUNT 6
+
+// policy names (as accepted by --policy), indexed by the POLICY_ constants
+static const char *const policy_names[POLICY_COUNT] = {"priority-lru", "lru", "plru", "srrip", "brrip", "random"};
+
+template <class Policy>
+struct PolicyType
+{
+    typedef Policy type;
+};
+
+// call f(PolicyType<P>()) for the replacement policy class P selected by policy. The choice is made once per run, so
+// every policy gets its own instantiation of the simulation loop with the policy calls inlined.
+template <class F>
+void with_policy(int policy, F f)
+{
+    switch (policy)
+    {
+    case POLICY_LRU:
+        f(PolicyType<LruPolicy>());
+        break;
+    case POLICY_TREE_PLRU:
+        f(PolicyType<TreePlruPolicy>());
+        break;
+    case POLICY_SRRIP:
+        f(PolicyType<SrripPolicy>());
+        break;
+    case POLICY_BRRIP:
+        f(PolicyType<BrripPolicy>());
+        break;
+    case POLICY_RANDOM:
+        f(PolicyType<RandomPolicy>());
+        break;
+    default:
+        f(PolicyType<PriorityLruPolicy>());
+        break;
+    }
+}
+
+// POLICY_ constant of a policy name, POLICY_COUNT if there is none
+static inline int find_policy(const char *name)
+{
+    for (int policy = 0; policy < POLICY_COUNT; policy++)
+    {
+        if (strcmp(policy_names[policy], name) == 0)
+        {
+            return policy;
+        }
+    }
+    return POLICY_COUNT;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef SET_SAMPLING_H
+#define SET_SAMPLING_H
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+#define SAMPLE_STRIDE 0 // sets 0, n, 2n, ...
+#define SAMPLE_HASH 1   // the sets with the smallest hashes of their index
+
+#define SAMPLE_CONFIDENCE_Z 1.96 // normal quantile of the reported 95% confidence intervals, for many sampled sets
+
+// two-sided 95% quantiles of Student's t distribution with 1 to 30 degrees of freedom
+static const double sample_confidence_t[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+// multiplier of the standard error in a 95% confidence interval with degrees of freedom (at least 1); past the
+// table, the quantile of the next smaller tabulated degrees of freedom, so the interval errs on the wide side
+static inline double confidence_quantile(long long int degrees)
+{
+    if (degrees <= 30)
+    {
+        return sample_confidence_t[degrees - 1];
+    }
+    if (degrees <= 40)
+    {
+        return 2.042;
+    }
+    if (degrees <= 60)
+    {
+        return 2.021;
+    }
+    if (degrees <= 120)
+    {
+        return 2.000;
+    }
+    return degrees <= 1000 ? 1.980 : SAMPLE_CONFIDENCE_Z;
+}
+
+/*
+    A sample of one set in ratio of a cache with total_sets sets (both powers of 2). Sets do not interact, so the
+    sampled sets behave exactly as in the full cache when they get the same accesses with the same sequence numbers;
+    they are simulated as a smaller cache of sets() sets by renumbering the block addresses (compact()) so that sampled
+    set k becomes set k and the tag is kept.
+*/
+class SetSample
+{
+public:
+    SetSample(int total_sets, int ratio, int mode)
+        : set_mask(total_sets - 1), set_bits(__builtin_ctz(total_sets)), sample_index(total_sets, -1), sampled(0), sampled_bits(0)
+    {
+        int count = total_sets / ratio;
+        std::vector<int> chosen;
+        if (mode == SAMPLE_STRIDE)
+        {
+            for (int s = 0; s < total_sets; s += ratio)
+            {
+                chosen.push_back(s);
+            }
+        }
+        else
+        {
+            std::vector<std::pair<uint64_t, int>> hashes;
+            for (int s = 0; s < total_sets; s++)
+            {
+                hashes.push_back({hash(s), s});
+            }
+            std::partial_sort(hashes.begin(), hashes.begin() + count, hashes.end());
+            for (int k = 0; k < count; k++)
+            {
+                chosen.push_back(hashes[k].second);
+            }
+            std::sort(chosen.begin(), chosen.end());
+        }
+
+        for (int s : chosen)
+        {
+            sample_index[s] = sampled++;
+        }
+        sampled_bits = __builtin_ctz(sampled);
+    }
+
+    int sets() const
+    {
+        return sampled;
+    }
+
+    // sampled set of block address, or -1 if its set is not sampled
+    int set(uint64_t address) const
+    {
+        return sample_index[address & set_mask];
+    }
+
+    // block address in the cache of the sampled sets; only for addresses of sampled sets
+    uint64_t compact(uint64_t address) const
+    {
+        return (address >> set_bits << sampled_bits) | sample_index[address & set_mask];
+    }
+
+private:
+    static uint64_t hash(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t set_mask;
+    int set_bits;
+    std::vector<int> sample_index; // by set index of the full cache
+    int sampled;
+    int sampled_bits;
+};
+
+// ratio of hits to accesses in a cache, estimated from the sampled sets with a 95% confidence interval
+struct RatioEstimate
+{
+    double ratio;
+    bool bounded; // false if there is no interval (fewer than 2 sampled sets, or no accesses): low = high = ratio
+    double low;
+    double high;
+};
+
+/*
+    Ratio estimator of cluster sampling, the sets being the clusters: ratio is the hits over the accesses of the
+    sampled sets, and its variance (1 - f) / (m * mean accesses^2) * sum((hits - ratio * accesses)^2) / (m - 1), with m
+    the sampled sets and f = m / total_sets. The interval is the ratio plus or minus the standard error times the
+    quantile of Student's t with m - 1 degrees of freedom, which is much wider than the normal 1.96 for the few sets
+    of a heavily sampled small cache. There is no interval with fewer than 2 sampled sets or no accesses.
+*/
+static inline RatioEstimate estimate_ratio(const std::vector<long long int> &accesses, const std::vector<long long int> &hits, int total_sets)
+{
+    double m = accesses.size();
+    double total_accesses = 0, total_hits = 0;
+    for (size_t s = 0; s < accesses.size(); s++)
+    {
+        total_accesses += accesses[s];
+        total_hits += hits[s];
+    }
+
+    RatioEstimate estimate = {total_accesses > 0 ? total_hits / total_accesses : 0, false, 0, 0};
+    estimate.low = estimate.high = estimate.ratio;
+    if (m < 2 || total_accesses == 0)
+    {
+        return estimate;
+    }
+
+    double squares = 0;
+    for (size_t s = 0; s < accesses.size(); s++)
+    {
+        double residual = hits[s] - estimate.ratio * accesses[s];
+        squares += residual * residual;
+    }
+    double mean_accesses = total_accesses / m;
+    double variance = (1 - m / total_sets) / (m * mean_accesses * mean_accesses) * squares / (m - 1);
+    double margin = confidence_quantile(accesses.size() - 1) * sqrt(std::max(0.0, variance));
+    estimate.bounded = true;
+    estimate.low = std::max(0.0, estimate.ratio - margin);
+    estimate.high = std::min(1.0, estimate.ratio + margin);
+    return estimate;
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SNAPSHOT_MAGIC "CSNP"
+#define SNAPSHOT_VERSION 1
+
+/*
+    Binary snapshot of the state of a simulation (see Cache::save()). Values are written in the byte order and layout
+    of the machine, so a snapshot is only read back by a build of the same simulator on the same kind of machine; the
+    header written by the caller identifies the configuration. A snapshot is written to a temporary file that replaces
+    the target once complete, so an interrupted run leaves the previous snapshot intact.
+
+    Errors do not stop the program: the first failed read or write makes ok() false and later calls do nothing.
+*/
+class SnapshotWriter
+{
+public:
+    SnapshotWriter(const char *filename) : filename(filename), temporary(std::string(filename) + ".tmp"), failed(false)
+    {
+        file = fopen(temporary.c_str(), "wb");
+        failed = file == NULL;
+        write(SNAPSHOT_MAGIC, 4);
+        write_value((uint32_t)SNAPSHOT_VERSION);
+    }
+
+    // an unfinished snapshot is discarded
+    ~SnapshotWriter()
+    {
+        if (file != NULL)
+        {
+            fclose(file);
+            remove(temporary.c_str());
+        }
+    }
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    void write(const void *data, size_t size)
+    {
+        failed = failed || fwrite(data, 1, size, file) != size;
+    }
+
+    template <class T>
+    void write_value(const T &value)
+    {
+        write(&value, sizeof(value));
+    }
+
+    template <class T>
+    void write_vector(const std::vector<T> &values)
+    {
+        write_value((uint64_t)values.size());
+        write(values.data(), values.size() * sizeof(T));
+    }
+
+    // finish the snapshot and move it in place; false if it could not be written
+    bool close()
+    {
+        if (file != NULL)
+        {
+            failed = fclose(file) != 0 || failed;
+            file = NULL;
+            failed = failed || rename(temporary.c_str(), filename.c_str()) != 0;
+            if (failed)
+            {
+                remove(temporary.c_str());
+            }
+        }
+        return !failed;
+    }
+
+    bool ok() const
+    {
+        return !failed;
+    }
+
+private:
+    std::string filename;
+    std::string temporary;
+    FILE *file;
+    bool failed;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(const char *filename)
+    {
+        file = fopen(filename, "rb");
+        failed = file == NULL;
+
+        char magic[4];
+        uint32_t version;
+        read(magic, 4);
+        read_value(version);
+        failed = failed || memcmp(magic, SNAPSHOT_MAGIC, 4) != 0 || version != SNAPSHOT_VERSION;
+    }
+
+    ~SnapshotReader()
+    {
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+    }
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+    void read(void *data, size_t size)
+    {
+        failed = failed || fread(data, 1, size, file) != size;
+        if (failed)
+        {
+            memset(data, 0, size);
+        }
+    }
+
+    template <class T>
+    void read_value(T &value)
+    {
+        read(&value, sizeof(value));
+    }
+
+    // read into values, which must already have the size stored in the snapshot
+    template <class T>
+    void read_vector(std::vector<T> &values)
+    {
+        uint64_t size;
+        read_value(size);
+        failed = failed || size != values.size();
+        read(values.data(), values.size() * sizeof(T));
+    }
+
+    // true if everything so far was read and nothing is left
+    bool finish()
+    {
+        failed = failed || fgetc(file) != EOF;
+        return !failed;
+    }
+
+    bool ok() const
+    {
+        return !failed;
+    }
+
+private:
+    FILE *file;
+    bool failed;
+};
+
+#endif
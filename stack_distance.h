@@ -0,0 +1,181 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+
+#define STACK_DISTANCE_MIN_POSITIONS 16 // positions of a set when its first block is inserted
+
+/*
+    LRU stack distances (Mattson et al.) of a trace of block addresses, for the caches of 2^l sets of every l up to
+    max_line_bits, collected in one pass. The stack distance of an access in a cache of S sets is the number of distinct
+    blocks of its set accessed since the previous access to its block. With write allocate, reads and writes alike make
+    a block the most recently used of its set, so an LRU cache of S sets and A ways hits exactly the accesses of
+    distance below A, and hits() gives the hits of every cache of at most 2^max_line_bits lines.
+
+    Every set of every level keeps its blocks at positions ordered by their latest access, with a Fenwick tree over
+    the positions marking those still holding a block. The distance of an access is the number of marked positions
+    after that of its block, which then moves to a new last position: O(log n) per level. A set that runs out of
+    positions renumbers its blocks in order, at a linear cost amortized over the accesses that used the positions.
+
+    Only the bucket of each distance is counted (0 in bucket 0, [2^(k-1), 2^k) in bucket k), which is all the hits of
+    power of 2 associativities need.
+*/
+class StackDistanceProfile
+{
+public:
+    StackDistanceProfile(int max_line_bits) : levels(max_line_bits + 1), total_accesses(0)
+    {
+        for (int l = 0; l <= max_line_bits; l++)
+        {
+            levels[l].sets.resize((size_t)1 << l);
+            levels[l].buckets.resize(max_line_bits - l + 2); // the last one holds the distances no cache hits
+        }
+    }
+
+    // access to block address, repeated repeat times in a row (the repetitions have distance 0)
+    void access(uint64_t address, long long int repeat = 1)
+    {
+        auto found = ids.emplace(address, (int)ids.size());
+        int id = found.first->second;
+        for (size_t l = 0; l < levels.size(); l++)
+        {
+            Level &level = levels[l];
+            if (found.second)
+            {
+                level.position.push_back(-1);
+            }
+
+            long long int distance = touch(level.sets[address & (((uint64_t)1 << l) - 1)], level.position, id);
+            if (distance >= 0)
+            {
+                level.buckets[bucket(distance, level.buckets.size())]++;
+            }
+            level.buckets[0] += repeat - 1;
+        }
+        total_accesses += repeat;
+    }
+
+    // hits of the LRU cache of 2^set_bits sets of ways lines (a power of 2), with set_bits + log2(ways) <= max_line_bits
+    long long int hits(int set_bits, int ways) const
+    {
+        const std::vector<long long int> &buckets = levels[set_bits].buckets;
+        long long int hits = 0;
+        for (int b = 0; b <= __builtin_ctz(ways); b++)
+        {
+            hits += buckets[b];
+        }
+        return hits;
+    }
+
+    long long int accesses() const
+    {
+        return total_accesses;
+    }
+
+    // distinct blocks accessed
+    long long int blocks() const
+    {
+        return ids.size();
+    }
+
+private:
+    struct DistanceSet
+    {
+        std::vector<int> tree;  // Fenwick tree over the positions, 1 at the latest position of each block
+        std::vector<int> owner; // block id at each position used so far, -1 once the block has moved on
+        int live = 0;           // blocks of the set
+    };
+
+    struct Level
+    {
+        std::vector<DistanceSet> sets;
+        std::vector<int> position;            // of each block id in its set, -1 before its first access
+        std::vector<long long int> buckets;   // accesses by bucket of distance
+    };
+
+    static size_t bucket(long long int distance, size_t buckets)
+    {
+        size_t b = distance == 0 ? 0 : 64 - __builtin_clzll(distance);
+        return b < buckets ? b : buckets - 1;
+    }
+
+    // distance of an access to block id of set, which moves to the last position; -1 on the first access to the block
+    static long long int touch(DistanceSet &set, std::vector<int> &position, int id)
+    {
+        long long int distance = -1;
+        int p = position[id];
+        if (p >= 0)
+        {
+            distance = set.live - marked_up_to(set.tree, p);
+            mark(set.tree, p, -1);
+            set.owner[p] = -1;
+            set.live--;
+        }
+
+        if (set.owner.size() == set.tree.size())
+        {
+            renumber(set, position);
+        }
+        p = set.owner.size();
+        set.owner.push_back(id);
+        mark(set.tree, p, 1);
+        set.live++;
+        position[id] = p;
+        return distance;
+    }
+
+    // marked positions in [0, p]
+    static int marked_up_to(const std::vector<int> &tree, int p)
+    {
+        int count = 0;
+        for (int i = p + 1; i > 0; i -= i & -i)
+        {
+            count += tree[i - 1];
+        }
+        return count;
+    }
+
+    static void mark(std::vector<int> &tree, int p, int delta)
+    {
+        for (int i = p + 1; i <= (int)tree.size(); i += i & -i)
+        {
+            tree[i - 1] += delta;
+        }
+    }
+
+    // move the blocks of set to positions [0, live) in the same order, with room for as many new ones
+    static void renumber(DistanceSet &set, std::vector<int> &position)
+    {
+        int live = 0;
+        for (int id : set.owner)
+        {
+            if (id >= 0)
+            {
+                set.owner[live] = id;
+                position[id] = live++;
+            }
+        }
+        set.owner.resize(live);
+
+        int positions = std::max(STACK_DISTANCE_MIN_POSITIONS, 2 * live);
+        set.tree.assign(positions, 0);
+        for (int i = 1; i <= positions; i++)
+        {
+            set.tree[i - 1] += i <= live;
+            int parent = i + (i & -i);
+            if (parent <= positions)
+            {
+                set.tree[parent - 1] += set.tree[i - 1];
+            }
+        }
+    }
+
+    std::vector<Level> levels; // by log2 of the number of sets
+    std::unordered_map<uint64_t, int> ids; // dense id of every block address
+    long long int total_accesses;
+};
+
+#endif
@@ -1,102 +1,656 @@
-#include <stdlib.h>
 #include <iostream>
 #include <vector>
-#include <fstream>
-#include <time.h>
+#include <string>
+#include <thread>
+#include <numeric>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "trace_reader.h"
+#include "binary_trace.h"
 
 using namespace std;
 
-#define MAX_MEM_ADDRESS 512
-#define MAX_DATA 1024
-#define R 1
-#define W 0
+#define MAX_DATA 1024                       // default largest word written by W requests
+#define GENERATOR_CHUNK_ACCESSES (1 << 20)  // accesses generated at once by one thread
+#define GENERATOR_MAX_TABLE (1 << 26)       // largest --addresses of the zipf and weighted workloads
+
+#define WORKLOAD_UNIFORM 0
+#define WORKLOAD_ZIPF 1
+#define WORKLOAD_WEIGHTED 2
+#define WORKLOAD_SCAN 3
+#define WORKLOAD_CHASE 4
+#define WORKLOAD_COUNT 5
 
-int get_ceil(int arr[], int r, int l, int h)
+static const char *const workload_names[WORKLOAD_COUNT] = {"uniform", "zipf", "weighted", "scan", "chase"};
+
+// index of a workload name, or WORKLOAD_COUNT; strided is a scan with --stride
+static int find_workload(const string &name)
 {
-    int mid;
-    while (l < h)
+    for (int workload = 0; workload < WORKLOAD_COUNT; workload++)
     {
-        mid = l + ((h - l) >> 1);
-        (r > arr[mid]) ? (l = mid + 1) : (h = mid);
+        if (name == workload_names[workload])
+        {
+            return workload;
+        }
     }
-    return (arr[l] >= r) ? l : -1;
+    return name == "strided" ? WORKLOAD_SCAN : WORKLOAD_COUNT;
 }
 
-int get_random_from_freq(vector<int> &arr, vector<int> &freq)
+static inline uint64_t splitmix64(uint64_t &state)
 {
-    int n = arr.size();
-    int prefix[n], i;
-    prefix[0] = freq.at(0);
-    for (i = 1; i < n; ++i)
-        prefix[i] = prefix[i - 1] + freq.at(i);
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
 
-    int r = (rand() % prefix[n - 1]) + 1;
+// xoshiro256** generator, seeded through splitmix64
+class Random
+{
+public:
+    Random(uint64_t seed)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            s[i] = splitmix64(seed);
+        }
+    }
 
-    int indexc = get_ceil(prefix, r, 0, n - 1);
-    return arr.at(indexc);
-}
+    uint64_t next()
+    {
+        uint64_t result = rotate(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotate(s[3], 45);
+        return result;
+    }
+
+    // uniform in [0, n), by multiplication instead of a division
+    uint64_t below(uint64_t n)
+    {
+        return (uint64_t)(((unsigned __int128)next() * n) >> 64);
+    }
+
+    // uniform in [0, 1)
+    double unit()
+    {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+private:
+    static inline uint64_t rotate(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t s[4];
+};
+
+/*
+    Walker's alias method (Vose's construction): samples index i with probability weights[i] / sum of the weights in
+    O(1), with one uniform column and one biased coin per sample.
+*/
+class AliasTable
+{
+public:
+    AliasTable() {}
+
+    AliasTable(const vector<double> &weights) : probability(weights.size()), alias(weights.size())
+    {
+        size_t n = weights.size();
+        double total = accumulate(weights.begin(), weights.end(), 0.0);
+        vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; i++)
+        {
+            probability[i] = weights[i] * n / total;
+            alias[i] = i;
+            (probability[i] < 1 ? small : large).push_back(i);
+        }
+
+        while (!small.empty() && !large.empty())
+        {
+            uint32_t less = small.back();
+            uint32_t more = large.back();
+            small.pop_back();
+            alias[less] = more;
+            probability[more] -= 1 - probability[less];
+            if (probability[more] < 1)
+            {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        // whatever is left is 1 up to rounding
+        for (uint32_t i : large)
+        {
+            probability[i] = 1;
+        }
+        for (uint32_t i : small)
+        {
+            probability[i] = 1;
+        }
+    }
+
+    uint64_t sample(Random &random) const
+    {
+        uint64_t column = random.below(probability.size());
+        return random.unit() < probability[column] ? column : alias[column];
+    }
+
+private:
+    vector<double> probability;
+    vector<uint32_t> alias;
+};
+
+/*
+    Pseudo random permutation of [0, n) that needs no table: rounds of odd multiplication, xorshift and key addition
+    (each a bijection on the bits of the next power of 2), cycle walked until the result is below n.
+*/
+class Permutation
+{
+public:
+    Permutation(uint64_t n, uint64_t seed) : n(n), bits(0)
+    {
+        while (bits < 64 && (1ULL << bits) < n)
+        {
+            bits++;
+        }
+        mask = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+        for (int round = 0; round < 3; round++)
+        {
+            multipliers[round] = splitmix64(seed) | 1;
+            keys[round] = splitmix64(seed);
+        }
+    }
 
-void generate(string filename, int access_requests, int distinct_mem_address)
+    uint64_t operator()(uint64_t x) const
+    {
+        do
+        {
+            x = mix(x);
+        } while (x >= n);
+        return x;
+    }
+
+private:
+    uint64_t mix(uint64_t x) const
+    {
+        for (int round = 0; round < 3; round++)
+        {
+            x = (x * multipliers[round]) & mask;
+            x ^= x >> (bits / 2 + 1);
+            x = (x + keys[round]) & mask;
+        }
+        return x;
+    }
+
+    uint64_t n;
+    int bits;
+    uint64_t mask;
+    uint64_t multipliers[3];
+    uint64_t keys[3];
+};
+
+struct Phase
 {
-    ofstream inputfile;
-    inputfile.open(filename);
-    srand(time(0));
+    int workload;
+    uint64_t accesses;
+};
 
-    // random memory addresses generated with random frequency
-    vector<int> memory_address_vector;
-    vector<int> memory_address_freq;
-    int frequency_total = 0;
+struct GeneratorOptions
+{
+    const char *filename = NULL;
+    uint64_t accesses = 10000;
+    vector<Phase> phases;           // repeated until accesses are generated; one phase of --workload by default
+    int workload = WORKLOAD_UNIFORM;
+    uint64_t addresses = 512;       // distinct block addresses: base, base + stride, ...
+    uint64_t base = 0;
+    uint64_t stride = 1;
+    double zipf_alpha = 0.99;
+    double read_fraction = 0.65;
+    long long int max_data = MAX_DATA;
+    int header[4] = {16, 2, 2, 4};  // cache size, block size, associativity and T written to the trace
+    bool binary = false;
+    uint64_t seed = 1;
+    int threads = max(1, (int)thread::hardware_concurrency());
+};
 
-    for (int i = 0; i < distinct_mem_address; i++)
+// accesses [first, first + accesses.size()) of the trace
+struct Chunk
+{
+    uint64_t first;
+    vector<Access> accesses;
+    string text;                    // the accesses as text trace lines (text output only)
+    long long int reads;
+};
+
+/*
+    Generates the trace in independent chunks: the random numbers of chunk c come from a generator seeded by the seed
+    and c, and scan and chase positions are computed from the access index, so the trace only depends on the options
+    and not on the number of threads.
+*/
+class TraceGenerator
+{
+public:
+    TraceGenerator(const GeneratorOptions &options) : options(options), permutation(options.addresses, options.seed)
     {
-        memory_address_vector.push_back(rand() % (MAX_MEM_ADDRESS + 1));
-        int rand_freq = rand() % (MAX_MEM_ADDRESS + 1);
-        memory_address_freq.push_back(rand_freq);
-        frequency_total += rand_freq;
+        bool zipf = false, weighted = false;
+        cycle = 0;
+        for (const Phase &phase : options.phases)
+        {
+            zipf = zipf || phase.workload == WORKLOAD_ZIPF;
+            weighted = weighted || phase.workload == WORKLOAD_WEIGHTED;
+            cycle += phase.accesses;
+        }
+
+        if (zipf)
+        {
+            vector<double> weights(options.addresses);
+            for (uint64_t rank = 0; rank < options.addresses; rank++)
+            {
+                weights[rank] = pow((double)(rank + 1), -options.zipf_alpha);
+            }
+            zipf_table = AliasTable(weights);
+        }
+        if (weighted)
+        {
+            Random random(options.seed ^ 0x5bd1e995ULL);
+            vector<double> weights(options.addresses);
+            for (double &weight : weights)
+            {
+                weight = random.unit() + 1e-9;
+            }
+            weighted_table = AliasTable(weights);
+        }
     }
 
-    // read or writes generated with frequency as specified in read_or_write_freq vector
-    vector<int> read_or_write_vector{R, W};
-    vector<int> read_or_write_freq{1, 1};
+    void generate(Chunk &chunk, uint64_t first, uint64_t count) const
+    {
+        uint64_t chunk_state = first / GENERATOR_CHUNK_ACCESSES;
+        Random random(options.seed ^ splitmix64(chunk_state));
+
+        chunk.first = first;
+        chunk.accesses.resize(count);
+        chunk.reads = 0;
+        uint64_t i = 0;
+        while (i < count)
+        {
+            // the run of accesses in the current phase
+            uint64_t offset = (first + i) % cycle;
+            size_t p = 0;
+            while (offset >= options.phases[p].accesses)
+            {
+                offset -= options.phases[p].accesses;
+                p++;
+            }
+            uint64_t run = min(count - i, options.phases[p].accesses - offset);
+            for (uint64_t position = offset; position < offset + run; position++, i++)
+            {
+                Access &access = chunk.accesses[i];
+                access.address = options.base + block(options.phases[p].workload, position, random) * options.stride;
+                access.type = random.unit() < options.read_fraction ? R : W;
+                access.data = access.type == W ? (long long int)random.below(options.max_data + 1) : 0;
+                access.core = 0;
+                chunk.reads += access.type == R;
+            }
+        }
+
+        if (!options.binary)
+        {
+            format(chunk);
+        }
+    }
 
-    // generate input file
-    inputfile << "16 <cache size in bytes>\n2 <cache block size in bytes>\n2 <cache associativity>\n4 <T>\n";
+private:
+    // index of the block accessed at position of a phase of workload
+    uint64_t block(int workload, uint64_t position, Random &random) const
+    {
+        switch (workload)
+        {
+        case WORKLOAD_ZIPF:
+            return permutation(zipf_table.sample(random)); // the most popular blocks are scattered
+        case WORKLOAD_WEIGHTED:
+            return weighted_table.sample(random);
+        case WORKLOAD_SCAN:
+            return position % options.addresses;
+        case WORKLOAD_CHASE:
+            return permutation(position % options.addresses); // a fixed cycle through all blocks
+        default:
+            return random.below(options.addresses);
+        }
+    }
 
-    int total_reads = 0;
-    for (int i = 0; i < access_requests; i++)
+    static inline char *put_decimal(char *p, uint64_t value)
     {
-        int memory_address = get_random_from_freq(memory_address_vector, memory_address_freq);
-        int read_or_write = get_random_from_freq(read_or_write_vector, read_or_write_freq);
-        if (read_or_write == R)
+        char digits[20];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value != 0);
+        while (n > 0)
         {
-            total_reads++;
-            inputfile << memory_address << ", R" << endl;
+            *p++ = digits[--n];
         }
-        else
+        return p;
+    }
+
+    static void format(Chunk &chunk)
+    {
+        // at most 20 + 5 + 20 + 1 characters per line
+        chunk.text.resize(chunk.accesses.size() * 46);
+        char *p = &chunk.text[0];
+        for (const Access &access : chunk.accesses)
+        {
+            p = put_decimal(p, access.address);
+            if (access.type == R)
+            {
+                memcpy(p, ", R\n", 4);
+                p += 4;
+            }
+            else
+            {
+                memcpy(p, ", W, ", 5);
+                p = put_decimal(p + 5, access.data);
+                *p++ = '\n';
+            }
+        }
+        chunk.text.resize(p - chunk.text.data());
+    }
+
+    const GeneratorOptions &options;
+    uint64_t cycle; // accesses of all phases
+    Permutation permutation;
+    AliasTable zipf_table;
+    AliasTable weighted_table;
+};
+
+// parse a comma separated list of workload:accesses phases
+static vector<Phase> parse_phases(const char *list)
+{
+    vector<Phase> phases;
+    const char *p = list;
+    const char *end = list + strlen(list);
+    while (p < end)
+    {
+        const char *colon = strchr(p, ':');
+        int workload = colon != NULL ? find_workload(string(p, colon)) : WORKLOAD_COUNT;
+        uint64_t accesses = 0;
+        p = colon != NULL ? colon + 1 : end;
+        if (workload == WORKLOAD_COUNT || !parse_unsigned(p, end, accesses) || accesses == 0 || (p < end && *p != ','))
         {
-            inputfile << memory_address << ", W, " << rand() % (MAX_DATA + 1) << endl;
+            cout << "Invalid phases: " << list << endl;
+            exit(EXIT_FAILURE);
         }
+        phases.push_back({workload, accesses});
+        p += p < end;
     }
+    if (phases.empty())
+    {
+        cout << "Invalid phases: " << list << endl;
+        exit(EXIT_FAILURE);
+    }
+    return phases;
+}
 
-    cout << "Input file " << filename << " "
-         << "generated with: " << endl;
-    cout << "Number of memory access requests: " << access_requests << endl;
-    cout << "Read requests: " << total_reads << "   Write requests: " << access_requests - total_reads << endl;
-    cout << "Memory addresses & their freqeuncy in access requests: " << endl;
-    for (int i = 0; i < memory_address_vector.size(); i++)
+static uint64_t parse_count(const char *arg)
+{
+    const char *p = arg;
+    const char *end = arg + strlen(arg);
+    uint64_t value;
+    if (!parse_unsigned(p, end, value) || p != end)
     {
-        cout << i + 1 << ") memory address: " << memory_address_vector.at(i) << "      frequency: " << (float)memory_address_freq.at(i) * 100 / frequency_total << " %" << endl;
+        cout << "Invalid number: " << arg << endl;
+        exit(EXIT_FAILURE);
     }
+    return value;
+}
 
-    inputfile.close();
+static void write_text_header(FILE *file, const int header[4])
+{
+    fprintf(file, "%d <cache size in bytes>\n%d <cache block size in bytes>\n%d <cache associativity>\n%d <T>\n",
+            header[0], header[1], header[2], header[3]);
 }
 
-int main()
+/*
+    Usage: test_input_generator {output_file} [options]
+
+        --accesses n            access requests to generate (10000)
+        --workload name         uniform, zipf, weighted, scan (or strided) or chase (uniform)
+        --phases list           comma separated workload:accesses phases, repeated until --accesses are generated
+        --addresses n           distinct block addresses (512)
+        --base a                first block address (0)
+        --stride s              distance between the block addresses (1)
+        --zipf-alpha a          exponent of the zipf workload (0.99)
+        --reads percent         share of R requests (65)
+        --max-data n            largest word written by W requests (1024)
+        --cache size,block,associativity,T
+                                cache parameters written to the trace (16,2,2,4)
+        --binary                write a packed binary trace (see binary_trace.h)
+        --seed n                seed of the random numbers (1); the same options give the same trace
+        --threads n             generating threads (one per core)
+*/
+int main(int argc, char **argv)
 {
-    string filename = "input/graph/inp_graph.txt";
-    int access_requests = 20000; // number of cache access requests to generate
-    int distinct_mem_address = 20; // number of distinct memory addresses in requests
-    generate(filename, access_requests, distinct_mem_address);
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " {output_file} [options]" << endl;
+        exit(EXIT_SUCCESS);
+    }
+
+    GeneratorOptions options;
+    options.filename = argv[1];
+    for (int i = 2; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--binary")
+        {
+            options.binary = true;
+        }
+        else if (i + 1 < argc && arg == "--accesses")
+        {
+            options.accesses = parse_count(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--workload")
+        {
+            options.workload = find_workload(argv[++i]);
+            if (options.workload == WORKLOAD_COUNT)
+            {
+                cout << "Unknown workload: " << argv[i] << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (i + 1 < argc && arg == "--phases")
+        {
+            options.phases = parse_phases(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--addresses")
+        {
+            options.addresses = parse_count(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--base")
+        {
+            options.base = parse_count(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--stride")
+        {
+            options.stride = parse_count(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--zipf-alpha")
+        {
+            options.zipf_alpha = atof(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--reads")
+        {
+            options.read_fraction = min(100.0, max(0.0, atof(argv[++i]))) / 100;
+        }
+        else if (i + 1 < argc && arg == "--max-data")
+        {
+            options.max_data = min(parse_count(argv[++i]), (uint64_t)LLONG_MAX - 1);
+        }
+        else if (i + 1 < argc && arg == "--cache")
+        {
+            const char *list = argv[++i];
+            const char *p = list;
+            const char *end = list + strlen(list);
+            for (int k = 0; k < 4; k++)
+            {
+                long long int value;
+                if (!parse_integer(p, end, value) || value < INT_MIN || value > INT_MAX || (p < end && *p++ != ','))
+                {
+                    cout << "Invalid cache: " << list << endl;
+                    exit(EXIT_FAILURE);
+                }
+                options.header[k] = (int)value;
+            }
+            if (p != end)
+            {
+                cout << "Invalid cache: " << list << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (i + 1 < argc && arg == "--seed")
+        {
+            options.seed = parse_count(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--threads")
+        {
+            options.threads = max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            cout << "Unknown argument: " << arg << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (options.phases.empty())
+    {
+        options.phases.push_back({options.workload, max<uint64_t>(options.accesses, 1)});
+    }
+    if (options.addresses == 0 || options.stride == 0)
+    {
+        cout << "--addresses and --stride must be positive" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.addresses - 1 > (UINT64_MAX - options.base) / options.stride)
+    {
+        cout << "The addresses do not fit in 64 bits" << endl;
+        exit(EXIT_FAILURE);
+    }
+    for (const Phase &phase : options.phases)
+    {
+        if ((phase.workload == WORKLOAD_ZIPF || phase.workload == WORKLOAD_WEIGHTED) && options.addresses > GENERATOR_MAX_TABLE)
+        {
+            cout << "The " << workload_names[phase.workload] << " workload takes at most " << GENERATOR_MAX_TABLE << " addresses" << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    FILE *file = NULL;
+    BinaryTraceWriter *binary_writer = NULL;
+    if (options.binary)
+    {
+        binary_writer = new BinaryTraceWriter(options.filename, options.header[0], options.header[1], options.header[2], options.header[3]);
+    }
+    else
+    {
+        file = fopen(options.filename, "w");
+        if (file == NULL)
+        {
+            cout << "Cannot open " << options.filename << endl;
+            exit(EXIT_FAILURE);
+        }
+        setvbuf(file, NULL, _IOFBF, 1 << 20);
+        write_text_header(file, options.header);
+    }
+
+    TraceGenerator generator(options);
+    uint64_t chunks = (options.accesses + GENERATOR_CHUNK_ACCESSES - 1) / GENERATOR_CHUNK_ACCESSES;
+    long long int total_reads = 0;
+
+    // the threads generate a round of chunks while the previous round is written in order
+    vector<Chunk> generating(options.threads), writing;
+    for (uint64_t round = 0; round * options.threads < chunks + options.threads; round++)
+    {
+        vector<thread> workers;
+        for (int t = 0; t < options.threads; t++)
+        {
+            uint64_t c = round * options.threads + t;
+            if (c >= chunks)
+            {
+                generating[t].accesses.clear();
+                generating[t].text.clear();
+                continue;
+            }
+            uint64_t first = c * GENERATOR_CHUNK_ACCESSES;
+            uint64_t count = min<uint64_t>(GENERATOR_CHUNK_ACCESSES, options.accesses - first);
+            Chunk &chunk = generating[t];
+            workers.push_back(thread([&generator, &chunk, first, count]()
+                                     { generator.generate(chunk, first, count); }));
+        }
+
+        for (Chunk &chunk : writing)
+        {
+            if (binary_writer != NULL)
+            {
+                for (const Access &access : chunk.accesses)
+                {
+                    binary_writer->write(access);
+                }
+            }
+            else
+            {
+                fwrite(chunk.text.data(), 1, chunk.text.size(), file);
+            }
+            total_reads += chunk.accesses.empty() ? 0 : chunk.reads;
+        }
+
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+        if (workers.empty())
+        {
+            break;
+        }
+        swap(generating, writing);
+        generating.resize(options.threads);
+    }
+
+    if (binary_writer != NULL)
+    {
+        binary_writer->close();
+        delete binary_writer;
+    }
+    else if (fclose(file) != 0)
+    {
+        cout << "Cannot write " << options.filename << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    cout << "Input file " << options.filename << " generated with: " << endl;
+    cout << "Number of memory access requests: " << options.accesses << endl;
+    cout << "Read requests: " << total_reads << "   Write requests: " << options.accesses - total_reads << endl;
+    cout << "Workload:";
+    for (const Phase &phase : options.phases)
+    {
+        cout << " " << workload_names[phase.workload];
+        if (options.phases.size() > 1)
+        {
+            cout << ":" << phase.accesses;
+        }
+    }
+    cout << " over " << options.addresses << " block addresses from " << options.base << " with stride " << options.stride << endl;
 
     return 0;
-}
\ No newline at end of file
+}
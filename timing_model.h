@@ -0,0 +1,303 @@
+#ifndef TIMING_MODEL_H
+#define TIMING_MODEL_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <stdint.h>
+#include "trace_reader.h"
+
+#define TIMING_NO_BLOCK UINT64_MAX // write buffer entry that never coalesces (a victim, whose address is not known)
+#define TIMING_VICTIM_CACHE -2     // level that served a miss from the victim cache of the first level
+#define TIMING_VICTIM_LATENCY 1    // cycles a victim cache hit adds to the hit latency of the first level
+
+// percentiles of the access latencies reported by TimingModel
+static const double timing_percentiles[] = {50, 90, 99, 99.9};
+
+/*
+    Bounded write buffer between a cache and the next level. Entries drain in order, one every drain_cycles cycles,
+    starting as soon as the previous one is done. A write to a block that already waits in the buffer (not yet
+    draining) is merged into its entry; a write that finds the buffer full stalls until the oldest entry is done.
+*/
+class WriteBuffer
+{
+public:
+    WriteBuffer(int entries, long long int drain_cycles) : writes(0), coalesced(0), stalls(0), stall_cycles(0), entries(entries), drain_cycles(drain_cycles) {}
+
+    // put a write of block in the buffer at cycle now; returns the cycles it stalled
+    long long int write(uint64_t block, long long int now)
+    {
+        writes++;
+        drain(now);
+        if (block != TIMING_NO_BLOCK)
+        {
+            for (const Entry &entry : queue)
+            {
+                if (entry.block == block && entry.done - drain_cycles > now)
+                {
+                    coalesced++;
+                    return 0;
+                }
+            }
+        }
+
+        long long int stall = 0;
+        if ((int)queue.size() == entries)
+        {
+            stall = queue.front().done - now;
+            stalls++;
+            stall_cycles += stall;
+            now += stall;
+            drain(now);
+        }
+
+        long long int start = queue.empty() ? now : std::max(now, queue.back().done);
+        queue.push_back({block, start + drain_cycles});
+        return stall;
+    }
+
+    long long int writes;       // writes put in the buffer
+    long long int coalesced;    // merged into an entry already waiting
+    long long int stalls;       // writes that found the buffer full
+    long long int stall_cycles;
+
+private:
+    struct Entry
+    {
+        uint64_t block;
+        long long int done; // cycle the entry has reached the next level
+    };
+
+    // drop the entries done by cycle now
+    void drain(long long int now)
+    {
+        while (!queue.empty() && queue.front().done <= now)
+        {
+            queue.pop_front();
+        }
+    }
+
+    int entries;
+    long long int drain_cycles;
+    std::deque<Entry> queue;
+};
+
+/*
+    Miss status holding registers of a non-blocking cache: an entry holds the fetch of a block from its start to the
+    cycle its line is filled. An access to a block whose fetch is outstanding merges into its entry and waits for that
+    fill; a fetch that finds all entries busy stalls until the first one is done.
+*/
+class MshrFile
+{
+public:
+    MshrFile(int entries) : allocations(0), merges(0), stalls(0), stall_cycles(0), busy_cycles(0), peak(0), entries(entries) {}
+
+    // cycle the outstanding fetch of block is done if there is one at cycle now (the access merges into it), else 0
+    long long int merge(uint64_t block, long long int now)
+    {
+        for (const Entry &entry : active)
+        {
+            if (entry.block == block && entry.done > now)
+            {
+                merges++;
+                return entry.done;
+            }
+        }
+        return 0;
+    }
+
+    // start a fetch of block at cycle now taking latency cycles; returns the cycles it stalled for a free entry
+    long long int allocate(uint64_t block, long long int now, long long int latency)
+    {
+        retire(now);
+        long long int stall = 0;
+        if ((int)active.size() == entries)
+        {
+            long long int first = std::min_element(active.begin(), active.end(), [](const Entry &a, const Entry &b) { return a.done < b.done; })->done;
+            stall = first - now;
+            stalls++;
+            stall_cycles += stall;
+            now = first;
+            retire(now);
+        }
+
+        active.push_back({block, now + latency});
+        allocations++;
+        busy_cycles += latency;
+        peak = std::max(peak, (int)active.size());
+        return stall;
+    }
+
+    long long int allocations;
+    long long int merges;
+    long long int stalls;       // fetches that found every entry busy
+    long long int stall_cycles;
+    long long int busy_cycles;  // summed over the entries: the average occupancy is busy_cycles over the cycles
+    int peak;                   // most entries busy at once
+
+private:
+    struct Entry
+    {
+        uint64_t block;
+        long long int done; // cycle the line is filled
+    };
+
+    // free the entries done by cycle now
+    void retire(long long int now)
+    {
+        active.erase(std::remove_if(active.begin(), active.end(), [now](const Entry &entry) { return entry.done <= now; }), active.end());
+    }
+
+    int entries;
+    std::vector<Entry> active;
+};
+
+/*
+    Latency of the accesses of a blocking first level cache, one access at a time: every access takes the hit latency
+    of the first level, a fetch adds the hit latency of every lower level it reaches and the memory latency if it
+    misses in all of them, and the writes sent to the next level (write-through, write misses that do not allocate,
+    dirty victims) either wait for it or go through a WriteBuffer when it has entries. latencies holds the hit latency
+    of every level and then the memory latency; the writes take the latency of the level below the first one.
+
+    Fetches and buffer drains are not modeled as competing for the next level, and the writes of lower levels are off
+    the critical path. The average memory access time (AMAT) and latency percentiles of reads and writes are kept.
+
+    With MSHRs (mshr_entries > 0) the cache is non-blocking: an access that misses takes an MshrFile entry and the
+    next access starts one hit latency later without waiting for the fill (accesses are independent: a trace has no
+    dependencies). The fetches served by the victim cache, and the writes, still hold the accesses that follow.
+*/
+class TimingModel
+{
+public:
+    TimingModel(const std::vector<int> &latencies, int write_buffer_entries, int mshr_entries = 0)
+        : latencies(latencies), buffer(write_buffer_entries > 0 ? new WriteBuffer(write_buffer_entries, latencies[1]) : NULL),
+          mshrs(mshr_entries > 0 ? new MshrFile(mshr_entries) : NULL), cycle(0), end(0)
+    {
+    }
+
+    /*
+        Time an access of type to block. served is the level whose hit ended its fetch (the number of levels for main
+        memory, TIMING_VICTIM_CACHE for the victim cache), or -1 without a fetch; written is set if it writes its data
+        to the next level, and victims is the number of dirty lines it wrote back. An access that hits a line still on
+        its way (a late prefetch) waits for the cycle ready. Returns its latency.
+    */
+    long long int access(int type, uint64_t block, int served, bool written, int victims, long long int ready = 0)
+    {
+        long long int latency = latencies[0] + fetch_latency(served);
+        long long int stall = 0;
+        long long int merged = mshrs ? mshrs->merge(block, cycle) : 0;
+        if (merged > 0)
+        {
+            latency = std::max((long long int)latencies[0], merged - cycle);
+        }
+        else if (mshrs && served > 0)
+        {
+            stall = mshrs->allocate(block, cycle, latency);
+        }
+        latency = std::max(latency, ready - cycle);
+
+        // cycles until the next access starts
+        long long int issue = mshrs && served != TIMING_VICTIM_CACHE ? latencies[0] : latency;
+        long long int start = cycle + stall;
+        long long int writes = 0;
+        for (int v = 0; v < victims; v++)
+        {
+            writes += write(TIMING_NO_BLOCK, start + issue + writes);
+        }
+        if (written)
+        {
+            writes += write(block, start + issue + writes);
+        }
+
+        latency += stall + writes;
+        cycle = start + issue + writes;
+        end = std::max(end, start + latency);
+        (type == R ? read_latencies : write_latencies)[latency]++;
+        return latency;
+    }
+
+    // cycles a fetch served by level served takes below the first level (0 for -1, no fetch)
+    long long int fetch_latency(int served) const
+    {
+        if (served == TIMING_VICTIM_CACHE)
+        {
+            return TIMING_VICTIM_LATENCY;
+        }
+        long long int latency = 0;
+        for (int l = 1; l <= served; l++)
+        {
+            latency += latencies[l];
+        }
+        return latency;
+    }
+
+    // cycle the next access starts
+    long long int now() const
+    {
+        return cycle;
+    }
+
+    // cycles until all accesses so far are done
+    long long int cycles() const
+    {
+        return std::max(cycle, end);
+    }
+
+    // latency distribution of the reads or the writes: (latency, accesses) by increasing latency
+    const std::map<long long int, long long int> &latencies_of(int type) const
+    {
+        return type == R ? read_latencies : write_latencies;
+    }
+
+    // NULL without write buffer
+    const WriteBuffer *write_buffer() const
+    {
+        return buffer.get();
+    }
+
+    // NULL for a blocking cache
+    const MshrFile *mshr_file() const
+    {
+        return mshrs.get();
+    }
+
+private:
+    // cycles a write to the next level keeps the access waiting
+    long long int write(uint64_t block, long long int now)
+    {
+        return buffer != NULL ? buffer->write(block, now) : latencies[1];
+    }
+
+    std::vector<int> latencies;
+    std::unique_ptr<WriteBuffer> buffer; // NULL: writes wait for the next level
+    std::unique_ptr<MshrFile> mshrs;     // NULL: blocking
+    long long int cycle;
+    long long int end;                   // latest cycle an access is done
+    std::map<long long int, long long int> read_latencies;
+    std::map<long long int, long long int> write_latencies;
+};
+
+// smallest latency of at least percent of the accesses in distribution (see TimingModel::latencies_of())
+static inline long long int latency_percentile(const std::map<long long int, long long int> &distribution, double percent)
+{
+    long long int total = 0;
+    for (const auto &entry : distribution)
+    {
+        total += entry.second;
+    }
+
+    long long int seen = 0;
+    for (const auto &entry : distribution)
+    {
+        seen += entry.second;
+        if (seen * 100.0 >= total * percent)
+        {
+            return entry.first;
+        }
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <sys/stat.h>
+#include "trace_reader.h"
+#include "binary_trace.h"
+
+using namespace std;
+
+// convert a text trace (see input/) to the packed binary trace format
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " {text_input_file} {binary_output_file}" << endl;
+        exit(EXIT_SUCCESS);
+    }
+
+    TextTraceReader trace(argv[1]);
+
+    int cache_size, cache_block_size, cache_associativity, T;
+    trace.read_header(cache_size, cache_block_size, cache_associativity, T);
+
+    BinaryTraceWriter writer(argv[2], cache_size, cache_block_size, cache_associativity, T);
+    Access access;
+    while (trace.next(access))
+    {
+        writer.write(access);
+    }
+    writer.close();
+
+    // read the binary trace back and compare it with the text trace
+    TextTraceReader text(argv[1]);
+    text.read_header(cache_size, cache_block_size, cache_associativity, T);
+    BinaryTraceReader binary(argv[2]);
+    Access converted;
+    uint64_t checked = 0;
+    while (text.next(access))
+    {
+        if (!binary.next(converted) || converted.address != access.address || converted.type != access.type ||
+            (access.type == W && converted.data != access.data))
+        {
+            cout << "Conversion check failed at access request " << checked + 1 << endl;
+            exit(EXIT_FAILURE);
+        }
+        checked++;
+    }
+    if (binary.next(converted) || checked != binary.records())
+    {
+        cout << "Conversion check failed: " << binary.records() << " access requests written, " << checked << " read" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat text_stat, binary_stat;
+    stat(argv[1], &text_stat);
+    stat(argv[2], &binary_stat);
+    cout << "Converted " << writer.records() << " access requests: " << text_stat.st_size << " -> " << binary_stat.st_size << " bytes" << endl;
+
+    return 0;
+}
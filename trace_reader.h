@@ -0,0 +1,495 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <iostream>
+#include <stdint.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define R 1
+#define W 0
+#define TRACE_CHUNK_SIZE (1 << 20) // read size when the input cannot be memory mapped
+
+// one cache access request
+struct Access
+{
+    uint64_t address;   // block address
+    int type;           // R or W
+    long long int data; // write data (W only)
+    int core;           // issuing core in multi-core traces, 0 otherwise
+    int repeat = 1;     // identical consecutive accesses this record stands for (see CoalescingTraceReader)
+};
+
+// skip blanks inside a line
+static inline const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+// parse an unsigned decimal integer with leading blanks; false if there are no digits or it does not fit in 64 bits
+static inline bool parse_unsigned(const char *&p, const char *end, uint64_t &value)
+{
+    p = skip_blanks(p, end);
+    if (p == end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, (uint64_t)(*p - '0'), &value))
+        {
+            return false;
+        }
+        p++;
+    }
+    return true;
+}
+
+// parse a decimal integer with optional sign and leading blanks; false if there are no digits or it does not fit in a
+// long long int
+static inline bool parse_integer(const char *&p, const char *end, long long int &value)
+{
+    p = skip_blanks(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t result;
+    if (!parse_unsigned(p, end, result) || result > (uint64_t)LLONG_MAX + negative)
+    {
+        return false;
+    }
+    value = negative ? (long long int)(0 - result) : (long long int)result;
+    return true;
+}
+
+/*
+    Streaming reader for the text trace format:
+
+        <cache size>
+        <cache block size>
+        <cache associativity>
+        <T>
+        <address>, R
+        <address>, W, <data>
+
+    An access can be prefixed with the id of the core issuing it, as in "<core>: <address>, R", for multi-core
+    simulation. Empty lines and lines starting with '#' are skipped. Regular files are memory mapped, anything else (pipes,
+    /dev/stdin) is read in fixed-size chunks. Lines are parsed in place, so memory use does not depend on the length
+    of the trace.
+*/
+class TextTraceReader
+{
+public:
+    TextTraceReader(const char *filename)
+        : fd(-1), mapping(NULL), mapping_size(0), buffer(NULL), buffer_capacity(0), cursor(NULL), end(NULL), eof(true)
+    {
+        fd = open(filename, O_RDONLY);
+        if (fd < 0)
+        {
+            std::cout << "Could not open " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            if (st.st_size > 0)
+            {
+                void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED)
+                {
+                    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                    mapping = (char *)addr;
+                    mapping_size = st.st_size;
+                    cursor = mapping;
+                    end = mapping + mapping_size;
+                    return;
+                }
+            }
+            else
+            {
+                return; // empty file
+            }
+        }
+
+        // not mappable: fall back to chunked reads
+        buffer_capacity = TRACE_CHUNK_SIZE;
+        buffer = (char *)malloc(buffer_capacity);
+        if (buffer == NULL)
+        {
+            out_of_memory();
+        }
+        cursor = buffer;
+        end = buffer;
+        eof = false;
+    }
+
+    ~TextTraceReader()
+    {
+        if (mapping != NULL)
+        {
+            munmap(mapping, mapping_size);
+        }
+        free(buffer);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    // read the four configuration lines; a line without a number yields 0, a number that does not fit in an int is
+    // invalid input
+    void read_header(int &cache_size, int &cache_block_size, int &cache_associativity, int &T)
+    {
+        int *fields[4] = {&cache_size, &cache_block_size, &cache_associativity, &T};
+        for (int i = 0; i < 4; i++)
+        {
+            *fields[i] = 0;
+        }
+
+        const char *line, *line_end;
+        int line_count = 0;
+        while (line_count < 4 && next_line(line, line_end))
+        {
+            if (line == line_end || line[0] == '#')
+            {
+                continue;
+            }
+
+            long long int value = 0;
+            if (parse_integer(line, line_end, value))
+            {
+                if (value < INT_MIN || value > INT_MAX)
+                {
+                    invalid_input();
+                }
+                *fields[line_count] = (int)value;
+            }
+            line_count++;
+        }
+    }
+
+    // parse the next access; false at the end of the trace
+    bool next(Access &access)
+    {
+        const char *line, *line_end;
+        while (next_line(line, line_end))
+        {
+            if (line == line_end || line[0] == '#')
+            {
+                continue;
+            }
+
+            const char *p = line;
+            if (!parse_unsigned(p, line_end, access.address))
+            {
+                invalid_input();
+            }
+            access.core = 0;
+            access.repeat = 1;
+            if (p < line_end && *p == ':')
+            {
+                // core id prefix
+                access.core = (int)access.address;
+                p++;
+                if (!parse_unsigned(p, line_end, access.address))
+                {
+                    invalid_input();
+                }
+            }
+
+            long long int value;
+            p = (const char *)memchr(p, ',', line_end - p);
+            if (p == NULL)
+            {
+                instruction_error();
+            }
+
+            p = skip_blanks(p + 1, line_end);
+            if (p < line_end && *p == 'R')
+            {
+                access.type = R;
+            }
+            else if (p < line_end && *p == 'W')
+            {
+                access.type = W;
+            }
+            else
+            {
+                invalid_input();
+            }
+
+            p = skip_blanks(p + 1, line_end);
+            if (p < line_end && *p == ',')
+            {
+                p++;
+                if (!parse_integer(p, line_end, value))
+                {
+                    invalid_input();
+                }
+                access.data = value;
+            }
+            else if (p < line_end)
+            {
+                invalid_input();
+            }
+            else if (access.type == W)
+            {
+                instruction_error(); // write without data
+            }
+            else
+            {
+                access.data = 0;
+            }
+
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // next line without its terminator (and trailing '\r'); false at end of input
+    bool next_line(const char *&line, const char *&line_end)
+    {
+        const char *newline = (const char *)memchr(cursor, '\n', end - cursor);
+        while (newline == NULL && refill())
+        {
+            newline = (const char *)memchr(cursor, '\n', end - cursor);
+        }
+
+        if (newline == NULL)
+        {
+            if (cursor == end)
+            {
+                return false;
+            }
+            newline = end; // last line without terminator
+        }
+
+        line = cursor;
+        line_end = newline;
+        if (line_end > line && line_end[-1] == '\r')
+        {
+            line_end--;
+        }
+        cursor = newline < end ? newline + 1 : end;
+        return true;
+    }
+
+    // chunked mode: keep the unfinished line and append the next chunk; false if nothing more was read
+    bool refill()
+    {
+        if (eof)
+        {
+            return false;
+        }
+
+        size_t pending = end - cursor;
+        memmove(buffer, cursor, pending);
+        if (buffer_capacity - pending < TRACE_CHUNK_SIZE / 2)
+        {
+            buffer_capacity *= 2;
+            char *grown = (char *)realloc(buffer, buffer_capacity);
+            if (grown == NULL)
+            {
+                out_of_memory();
+            }
+            buffer = grown;
+        }
+
+        ssize_t bytes = read(fd, buffer + pending, buffer_capacity - pending);
+        if (bytes <= 0)
+        {
+            eof = true;
+            bytes = 0;
+        }
+        cursor = buffer;
+        end = buffer + pending + bytes;
+        return bytes > 0;
+    }
+
+    void invalid_input()
+    {
+        std::cout << "Invalid input" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    void instruction_error()
+    {
+        std::cout << "Instruction error" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    void out_of_memory()
+    {
+        std::cout << "Could not allocate the trace buffer" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int fd;
+    char *mapping;
+    size_t mapping_size;
+    char *buffer;
+    size_t buffer_capacity;
+    const char *cursor;
+    const char *end;
+    bool eof;
+};
+
+/*
+    Turns a trace of byte addresses into the block addresses the caches take: an access of access_size bytes at byte
+    address a covers the blocks a >> block_shift to (a + access_size - 1) >> block_shift, where block_shift is log2 of
+    the cache block size of the header. An access that straddles several blocks is returned once per block, with the
+    same type and data, so the statistics of the caches count block accesses. TraceReader is any of the readers; with
+    access_size 0, the addresses are read unchanged.
+*/
+template <class TraceReader>
+class ByteAddressTraceReader
+{
+public:
+    ByteAddressTraceReader(TraceReader &trace, int access_size)
+        : trace(trace), access_size(access_size), block_shift(0), pending(), remaining_blocks(0), bytes(0), straddling(0)
+    {
+    }
+
+    void read_header(int &cache_size, int &cache_block_size, int &cache_associativity, int &T)
+    {
+        trace.read_header(cache_size, cache_block_size, cache_associativity, T);
+        block_shift = cache_block_size > 0 ? __builtin_ctz(cache_block_size) : 0;
+    }
+
+    bool next(Access &access)
+    {
+        if (remaining_blocks > 0)
+        {
+            remaining_blocks--;
+            pending.address++;
+            access = pending;
+            return true;
+        }
+        if (!trace.next(access))
+        {
+            return false;
+        }
+        if (access_size == 0)
+        {
+            return true;
+        }
+
+        uint64_t first_byte = access.address;
+        uint64_t last_byte = first_byte + (access_size - 1) < first_byte ? UINT64_MAX : first_byte + (access_size - 1);
+        access.address = first_byte >> block_shift;
+        bytes++;
+        if ((last_byte >> block_shift) != access.address)
+        {
+            straddling++;
+            pending = access;
+            remaining_blocks = (last_byte >> block_shift) - access.address;
+        }
+        return true;
+    }
+
+    // accesses of the byte address trace so far
+    long long int byte_accesses() const
+    {
+        return bytes;
+    }
+
+    // accesses that covered more than one block
+    long long int straddling_accesses() const
+    {
+        return straddling;
+    }
+
+private:
+    TraceReader &trace;
+    uint64_t access_size;
+    int block_shift;
+    Access pending;            // the latest block of a straddling access
+    uint64_t remaining_blocks; // blocks of it still to be returned
+    long long int bytes;
+    long long int straddling;
+};
+
+/*
+    Coalesces runs of consecutive accesses to the same block, of the same type and core, into one record whose repeat
+    is the length of the run (at most max_repeat; with 1, the trace is read unchanged). A write record carries the data
+    of the last write of its run, the only one left in the cache; the first write of a run can miss and write its data
+    through to the next level, so it gets a record of its own when the data of the following writes is different.
+    The caches simulate a record exactly like the accesses it stands for (see Cache::access()), but look it up only
+    once. TraceReader is any of the readers.
+*/
+template <class TraceReader>
+class CoalescingTraceReader
+{
+public:
+    CoalescingTraceReader(TraceReader &trace, int max_repeat)
+        : trace(trace), max_repeat(max_repeat), following(), has_following(false), continues_run(false)
+    {
+    }
+
+    void read_header(int &cache_size, int &cache_block_size, int &cache_associativity, int &T)
+    {
+        trace.read_header(cache_size, cache_block_size, cache_associativity, T);
+    }
+
+    bool next(Access &access)
+    {
+        if (max_repeat <= 1)
+        {
+            return trace.next(access);
+        }
+        if (!has_following && !trace.next(following))
+        {
+            return false;
+        }
+
+        access = following;
+        has_following = false;
+        bool run_head = !continues_run;
+        continues_run = false;
+        while (access.repeat < max_repeat && trace.next(following))
+        {
+            has_following = true;
+            if (following.address != access.address || following.type != access.type || following.core != access.core ||
+                following.repeat > max_repeat - access.repeat)
+            {
+                break;
+            }
+            if (run_head && access.type == W && following.data != access.data)
+            {
+                continues_run = true;
+                break;
+            }
+            has_following = false;
+            access.repeat += following.repeat;
+            access.data = following.data;
+        }
+        return true;
+    }
+
+private:
+    TraceReader &trace;
+    int max_repeat;
+    Access following; // read ahead, not part of the current record
+    bool has_following;
+    bool continues_run; // following is in the run of the previous record, whose first access left the line cached
+};
+
+#endif
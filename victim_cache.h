@@ -0,0 +1,133 @@
+#ifndef VICTIM_CACHE_H
+#define VICTIM_CACHE_H
+
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Small fully associative buffer of the lines evicted from a cache (Jouppi). The cache and its victim cache never
+    hold the same block: a miss that finds its block here takes the line back (take()), and the victim cache's own
+    victims leave the level in place of the lines put in it. Lines are never used in place, so replacing the oldest
+    one is LRU. Lines are block_words words.
+*/
+class VictimCache
+{
+public:
+    VictimCache(int entries, int block_words)
+        : lookups(0), hits(0), evictions(0), block_words(block_words), lines(entries), data(entries * block_words), displaced(block_words), clock(0)
+    {
+    }
+
+    // take the line of block address out if it is held: its data is copied to line and dirty is set
+    bool take(uint64_t address, long long int *line, bool &dirty)
+    {
+        lookups++;
+        int index = find(address);
+        if (index == -1)
+        {
+            return false;
+        }
+        hits++;
+        memcpy(line, data.data() + index * block_words, block_words * sizeof(long long int));
+        dirty = lines[index].dirty;
+        lines[index].valid = false;
+        return true;
+    }
+
+    // drop the line of block address if it is held (back-invalidation), merging its data into line if it is dirty;
+    // true if it was dirty
+    bool drop(uint64_t address, long long int *line)
+    {
+        int index = find(address);
+        if (index == -1)
+        {
+            return false;
+        }
+        lines[index].valid = false;
+        if (lines[index].dirty)
+        {
+            memcpy(line, data.data() + index * block_words, block_words * sizeof(long long int));
+        }
+        return lines[index].dirty;
+    }
+
+    // update a word of a held line written past the cache (a write miss that does not allocate)
+    void update(uint64_t address, int word, long long int value)
+    {
+        int index = find(address);
+        if (index != -1)
+        {
+            data[index * block_words + word] = value;
+        }
+    }
+
+    /*
+        Put the evicted line of block address in, replacing the least recently inserted one. Returns the data of the
+        line it displaced, with its address and dirty state, or NULL if there was a free entry. The data stays valid
+        until the next call.
+    */
+    const long long int *insert(uint64_t address, const long long int *line, bool dirty, uint64_t &displaced_address, bool &displaced_dirty)
+    {
+        int index = 0;
+        for (size_t e = 0; e < lines.size(); e++)
+        {
+            if (!lines[e].valid)
+            {
+                index = e;
+                break;
+            }
+            if (lines[e].inserted < lines[index].inserted)
+            {
+                index = e;
+            }
+        }
+
+        const long long int *result = NULL;
+        if (lines[index].valid)
+        {
+            evictions++;
+            displaced_address = lines[index].address;
+            displaced_dirty = lines[index].dirty;
+            memcpy(displaced.data(), data.data() + index * block_words, block_words * sizeof(long long int));
+            result = displaced.data();
+        }
+
+        lines[index] = {address, dirty, true, ++clock};
+        memcpy(data.data() + index * block_words, line, block_words * sizeof(long long int));
+        return result;
+    }
+
+    long long int lookups;   // misses of the cache that looked for their line here
+    long long int hits;
+    long long int evictions; // lines displaced out of the level
+
+private:
+    struct Line
+    {
+        uint64_t address;
+        bool dirty;
+        bool valid;
+        long long int inserted; // clock of the insertion
+    };
+
+    int find(uint64_t address) const
+    {
+        for (size_t e = 0; e < lines.size(); e++)
+        {
+            if (lines[e].valid && lines[e].address == address)
+            {
+                return e;
+            }
+        }
+        return -1;
+    }
+
+    int block_words;
+    std::vector<Line> lines;
+    std::vector<long long int> data;
+    std::vector<long long int> displaced; // data of the latest displaced line
+    long long int clock;
+};
+
+#endif